@@ -0,0 +1,249 @@
+#include <benchmark/benchmark.h>
+#include <boost/make_shared.hpp>
+
+#include <cmath>
+#include <random>
+
+#include "gazebo_ros_actor_plugin/actor_path.h"
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+#include "gazebo_ros_actor_plugin/actor_worker_pool.h"
+#include "gazebo_ros_actor_plugin/crowd_avoidance.h"
+#include "gazebo_ros_actor_plugin/velocity_command_buffer.h"
+
+using namespace gazebo;
+
+namespace {
+/// \brief Time delta of a 1 kHz physics update.
+constexpr double kDt = 0.001;
+
+/// \brief Store of actors spread on a square, half following paths and
+/// half velocity commands.
+ActorStateStore MakeStore(size_t _n) {
+  ActorStateStore store;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> pos(-50, 50);
+  std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+  for (size_t i = 0; i < _n; ++i) {
+    store.Add(pos(rng), pos(rng), 1.0, yaw(rng));
+    if (i % 2 == 0) {
+      store.mode[i] = ACTOR_MODE_PATH;
+      store.target_x[i] = pos(rng);
+      store.target_y[i] = pos(rng);
+      store.has_target[i] = 1;
+    } else {
+      store.mode[i] = ACTOR_MODE_VELOCITY;
+      store.v[i] = 1.0;
+      store.w[i] = 0.2;
+    }
+  }
+  return store;
+}
+
+/// \brief Path of a random walk with the given number of poses.
+nav_msgs::Path::Ptr MakePath(size_t _n) {
+  auto msg = boost::make_shared<nav_msgs::Path>();
+  msg->poses.resize(_n);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> turn(-0.3, 0.3);
+  double x = 0, y = 0, heading = 0;
+  for (geometry_msgs::PoseStamped &pose : msg->poses) {
+    heading += turn(rng);
+    x += 0.5 * std::cos(heading);
+    y += 0.5 * std::sin(heading);
+    pose.pose.position.x = x;
+    pose.pose.position.y = y;
+    pose.pose.orientation.z = std::sin(heading / 2);
+    pose.pose.orientation.w = std::cos(heading / 2);
+  }
+  return msg;
+}
+
+/// \brief Actor counts from 1 to 1000.
+void ActorCounts(benchmark::internal::Benchmark *_b) {
+  _b->RangeMultiplier(10)->Range(1, 1000);
+}
+
+/// \brief Waypoint counts from 10 to 100k.
+void WaypointCounts(benchmark::internal::Benchmark *_b) {
+  _b->RangeMultiplier(10)->Range(10, 100000);
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+// Batched kernel of the crowd manager
+static void BM_UpdateActorStates(benchmark::State &_state) {
+  ActorStateStore store = MakeStore(_state.range(0));
+  ActorKernelParams params;
+  params.ang_velocity = 0.2;
+  params.ang_tolerance = 0.1;
+  for (auto _ : _state) {
+    UpdateActorStates(store, params, kDt);
+    benchmark::DoNotOptimize(store.x.data());
+  }
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_UpdateActorStates)->Apply(ActorCounts);
+
+/////////////////////////////////////////////////
+// Steering of the actor plugin, one actor at a time
+static void BM_StepTowards(benchmark::State &_state) {
+  ActorStateStore store = MakeStore(_state.range(0));
+  ActorKernelParams params;
+  params.ang_velocity = 0.2;
+  params.ang_tolerance = 0.1;
+  for (auto _ : _state) {
+    for (size_t i = 0; i < store.Size(); ++i) {
+      ActorStep step =
+          StepTowards(store.x[i], store.y[i], store.yaw[i], store.target_x[i],
+                      store.target_y[i], params, kDt);
+      store.x[i] = step.x;
+      store.y[i] = step.y;
+      store.yaw[i] = step.yaw;
+    }
+    benchmark::DoNotOptimize(store.x.data());
+  }
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_StepTowards)->Apply(ActorCounts);
+
+/////////////////////////////////////////////////
+static void BM_StepVelocity(benchmark::State &_state) {
+  ActorStateStore store = MakeStore(_state.range(0));
+  ActorKernelParams params;
+  for (auto _ : _state) {
+    for (size_t i = 0; i < store.Size(); ++i) {
+      ActorStep step = StepVelocity(store.x[i], store.y[i], store.yaw[i], 1.0,
+                                    0.2, params, kDt);
+      store.x[i] = step.x;
+      store.y[i] = step.y;
+      store.yaw[i] = step.yaw;
+    }
+    benchmark::DoNotOptimize(store.x.data());
+  }
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_StepVelocity)->Apply(ActorCounts);
+
+/////////////////////////////////////////////////
+// Social force avoidance between the actors of a store
+static void BM_CrowdAvoidance(benchmark::State &_state) {
+  ActorStateStore store = MakeStore(_state.range(0));
+  UpdateActorStates(store, ActorKernelParams(), kDt);
+  CrowdAvoidance avoidance;
+  avoidance.BuildObstacles({{-1, -1, 1, 1}});
+  for (auto _ : _state) {
+    avoidance.Apply(store, kDt);
+    benchmark::DoNotOptimize(store.x.data());
+  }
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_CrowdAvoidance)->Apply(ActorCounts);
+
+/////////////////////////////////////////////////
+// Avoidance of the crowd manager with update_threads set to 4
+static void BM_CrowdAvoidanceParallel(benchmark::State &_state) {
+  ActorStateStore store = MakeStore(_state.range(0));
+  UpdateActorStates(store, ActorKernelParams(), kDt);
+  CrowdAvoidance avoidance;
+  avoidance.BuildObstacles({{-1, -1, 1, 1}});
+  ActorWorkerPool pool(4);
+  for (auto _ : _state) {
+    avoidance.Apply(store, kDt, &pool);
+    benchmark::DoNotOptimize(store.x.data());
+  }
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_CrowdAvoidanceParallel)->Apply(ActorCounts)->UseRealTime();
+
+/////////////////////////////////////////////////
+// Work of PathCallback: index a received path
+static void BM_PathFromMessage(benchmark::State &_state) {
+  nav_msgs::Path::ConstPtr msg = MakePath(_state.range(0));
+  for (auto _ : _state) benchmark::DoNotOptimize(ActorPath::FromMessage(msg));
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_PathFromMessage)->Apply(WaypointCounts);
+
+/////////////////////////////////////////////////
+// Work of PathCallback in steady state, reusing the paths of a pool
+static void BM_PathFromMessagePooled(benchmark::State &_state) {
+  nav_msgs::Path::ConstPtr msg = MakePath(_state.range(0));
+  ActorPathPool pool;
+  for (auto _ : _state)
+    benchmark::DoNotOptimize(ActorPath::FromMessage(msg, &pool));
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_PathFromMessagePooled)->Apply(WaypointCounts);
+
+/////////////////////////////////////////////////
+// Reading targets, which extracts the yaw of each pose quaternion
+static void BM_PathAt(benchmark::State &_state) {
+  ActorPathPtr path = ActorPath::FromMessage(MakePath(_state.range(0)));
+  for (auto _ : _state) {
+    for (size_t i = 0; i < path->Size(); ++i)
+      benchmark::DoNotOptimize(path->At(i));
+  }
+  _state.SetItemsProcessed(_state.iterations() * _state.range(0));
+}
+BENCHMARK(BM_PathAt)->Apply(WaypointCounts);
+
+/////////////////////////////////////////////////
+static void BM_PathClosestPoint(benchmark::State &_state) {
+  ActorPathPtr path = ActorPath::FromMessage(MakePath(_state.range(0)));
+  std::mt19937 rng(3);
+  const size_t n = path->Size();
+  std::uniform_int_distribution<size_t> index(0, n - 1);
+  for (auto _ : _state) {
+    const geometry_msgs::Point &near = path->Position(index(rng));
+    benchmark::DoNotOptimize(path->ClosestPoint(near.x + 0.2, near.y - 0.2));
+  }
+}
+BENCHMARK(BM_PathClosestPoint)->Apply(WaypointCounts);
+
+/////////////////////////////////////////////////
+// Pure pursuit of an actor walking the whole path
+static void BM_PathLookahead(benchmark::State &_state) {
+  ActorPathPtr path = ActorPath::FromMessage(MakePath(_state.range(0)));
+  double progress = 0;
+  double s = 0;
+  for (auto _ : _state) {
+    s += 0.05;
+    if (s > path->Length()) s = progress = 0;
+    PathPoint on = path->AtArcLength(s);
+    benchmark::DoNotOptimize(path->Lookahead(on.x, on.y, 1.0, progress));
+  }
+}
+BENCHMARK(BM_PathLookahead)->Apply(WaypointCounts);
+
+/////////////////////////////////////////////////
+// Work of PathUpdateCallback: append a few poses to a long path
+static void BM_PathAppend(benchmark::State &_state) {
+  ActorPathPtr base = ActorPath::FromMessage(MakePath(_state.range(0)));
+  nav_msgs::Path::ConstPtr poses = MakePath(10);
+  auto update = boost::make_shared<gazebo_ros_actor_plugin::PathUpdate>();
+  update->mode = gazebo_ros_actor_plugin::PathUpdate::APPEND;
+  update->poses = poses->poses;
+  gazebo_ros_actor_plugin::PathUpdate::ConstPtr msg = update;
+  for (auto _ : _state)
+    benchmark::DoNotOptimize(ActorPath::FromUpdate(base, msg));
+}
+BENCHMARK(BM_PathAppend)->Apply(WaypointCounts);
+
+/////////////////////////////////////////////////
+// Handoff of velocity commands from VelCallback to the update
+static void BM_VelocityCommandBuffer(benchmark::State &_state) {
+  VelocityCommandBuffer buffer;
+  buffer.Configure(CommandPolicy::LATEST, VelocityCommandBuffer::kCapacity, 0);
+  VelocityCommand cmd;
+  double now = 0;
+  for (auto _ : _state) {
+    cmd.stamp = now;
+    buffer.Push(cmd);
+    buffer.Next(now, cmd);
+    now += kDt;
+  }
+  _state.SetItemsProcessed(_state.iterations());
+}
+BENCHMARK(BM_VelocityCommandBuffer);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,255 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_COMMAND_ARBITER
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_COMMAND_ARBITER
+
+#include <gazebo_ros_actor_plugin/PathUpdate.h>
+#include <nav_msgs/Path.h>
+
+#include <ignition/math/Vector3.hh>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "gazebo_ros_actor_plugin/actor_diagnostics.h"
+#include "gazebo_ros_actor_plugin/actor_path.h"
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+#include "gazebo_ros_actor_plugin/velocity_command_buffer.h"
+
+namespace gazebo {
+
+/// \brief Parameters of the command arbitration, shared by the actors of a
+/// plugin.
+struct ArbiterParams {
+  /// \brief Mode of the actor after a reset.
+  ActorMode initial_mode = ACTOR_MODE_IDLE;
+
+  /// \brief How pending velocity commands are consumed.
+  CommandPolicy policy = CommandPolicy::FIFO;
+
+  /// \brief Maximum number of pending velocity commands.
+  size_t queue_size = VelocityCommandBuffer::kMaxQueueSize;
+
+  /// \brief Time without velocity command after which the actor stops,
+  /// zero disables it.
+  double command_timeout = 0;
+
+  /// \brief How velocity commands interact with the other modes.
+  CommandArbitration arbitration = CommandArbitration::NONE;
+
+  /// \brief Time without velocity command after which a preempted mode
+  /// resumes.
+  double preempt_timeout = 1.0;
+
+  /// \brief Where to start following a full path, ActorPath::RESUME_START
+  /// or ActorPath::RESUME_CLOSEST.
+  ActorPath::Resume path_resume = ActorPath::RESUME_START;
+
+  /// \brief Pick up paths once the simulation time reaches their stamp.
+  bool lockstep = false;
+
+  /// \brief Distance along the path at which the actor aims, zero to walk
+  /// from pose to pose.
+  double lookahead = 0;
+
+  /// \brief Distance to a target pose at which it is reached.
+  double lin_tolerance = 0.1;
+};
+
+/// \brief Commands of one actor, from the ROS callbacks that receive them
+/// to the mode, velocity and path target the update thread drives it with.
+///
+/// Both the actor plugin and the crowd manager hold one per actor, so the
+/// mode switches, the preemption of the path and idle modes by velocity
+/// commands and the pickup of new paths behave the same in both. The
+/// callbacks hand commands over without blocking the update thread, every
+/// other method is only called by the update thread.
+class ActorCommandArbiter {
+ public:
+  /// \brief Set the parameters, before any other call.
+  /// \param[in] _name Name of the actor, used in the log messages.
+  /// \param[in] _params Parameters of the arbitration.
+  void Configure(const std::string &_name, const ArbiterParams &_params);
+
+#ifdef ACTOR_DIAGNOSTICS
+  /// \brief Measure the latencies of the velocity commands and paths in
+  /// the given diagnostics.
+  /// \param[in] _diagnostics Hot path measurements of the actor.
+  void SetDiagnostics(ActorDiagnostics *_diagnostics) {
+    this->diagnostics_ = _diagnostics;
+  }
+#endif
+
+  /// \brief Hand a velocity command over, called by the ROS callbacks.
+  /// \param[in] _cmd Received command.
+  /// \return False if the buffer overflowed, see
+  /// VelocityCommandBuffer::Push.
+  bool PushVelocity(const VelocityCommand &_cmd);
+
+  /// \brief Hand a full path over, called by the ROS callbacks.
+  /// \param[in] _msg Received path.
+  void SetPath(const nav_msgs::Path::ConstPtr &_msg);
+
+  /// \brief Hand an incremental update of the latest path over, called by
+  /// the ROS callbacks.
+  /// \param[in] _msg Received update.
+  void UpdatePath(const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &_msg);
+
+  /// \brief Abort the path or cancel the abort, called by the ROS
+  /// callbacks. Later updates start a new path instead of extending the
+  /// aborted one.
+  /// \param[in] _abort Whether the path is aborted.
+  void Abort(bool _abort);
+
+  /// \brief Request a mode switch, picked up by TakeRequestedMode(),
+  /// called by the ROS callbacks.
+  /// \param[in] _name Name of the mode.
+  /// \param[out] _message Description of the outcome.
+  /// \return False if the mode is unknown.
+  bool RequestMode(const std::string &_name, std::string &_message);
+
+  /// \brief Drop every command and stand at a pose, in the initial mode.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \param[in] _yaw Yaw of the actor.
+  void Reset(double _x, double _y, double _yaw);
+
+  /// \brief Take the mode switch requested since the last call, if any.
+  /// \param[out] _mode Requested mode.
+  /// \return False if no switch is requested.
+  bool TakeRequestedMode(ActorMode &_mode);
+
+  /// \brief Switch to another mode. Velocity commands sent before a switch
+  /// to velocity mode are dropped, and the new mode is not preempted.
+  /// \param[in] _mode New mode.
+  void SwitchMode(ActorMode _mode);
+
+  /// \brief Take the velocity command of this control tick, and decide
+  /// whether velocity commands drive the actor, following the command
+  /// arbitration in the path and idle modes.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \return True if the actor follows Linear() and Angular() at this tick.
+  bool Arbitrate(double _now, double _x, double _y);
+
+  /// \brief Pick up a path handed over since the last tick, and choose the
+  /// target of the path mode.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \param[out] _target Position and yaw of the target.
+  /// \return False if the actor has no target: the path is aborted, empty
+  /// or done.
+  bool PathTarget(double _now, double _x, double _y,
+                  ignition::math::Vector3d &_target);
+
+  /// \brief Current mode.
+  ActorMode Mode() const { return this->mode_; }
+
+  /// \brief Mode after a reset.
+  ActorMode InitialMode() const { return this->params_.initial_mode; }
+
+  /// \brief Whether velocity commands currently preempt the mode.
+  bool Preempted() const { return this->preempted_; }
+
+  /// \brief Commanded linear velocity.
+  double Linear() const { return this->linear_; }
+
+  /// \brief Commanded angular velocity.
+  double Angular() const { return this->angular_; }
+
+  /// \brief Whether the path is aborted.
+  bool Aborted() const { return this->abort_; }
+
+  /// \brief Path currently followed.
+  const ActorPathPtr &Path() const { return this->path_; }
+
+  /// \brief Index of the current target pose on the path.
+  size_t Index() const { return this->idx_; }
+
+  /// \brief Arc length of the path reached, when looking ahead.
+  double Progress() const { return this->progress_; }
+
+  /// \brief Number of pending velocity commands.
+  size_t PendingCommands() const { return this->cmd_queue_.Size(); }
+
+ private:
+  /// \brief Value of requested_mode_ when no switch is pending.
+  static constexpr uint8_t kNoModeRequest = 0xff;
+
+  /// \brief Take the velocity command of this tick, if any.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \return True if a received command is applied at this tick.
+  bool PullVelocity(double _now);
+
+  /// \brief Hand a new path over to the update thread.
+  /// Must be called with path_mutex_ held.
+  /// \param[in] _path Path built by a ROS callback.
+  void HandOverPath(const std::shared_ptr<ActorPath> &_path);
+
+  /// \brief Name of the actor.
+  std::string name_;
+
+  /// \brief Parameters of the arbitration.
+  ArbiterParams params_;
+
+  /// \brief Velocity commands handed from the ROS callbacks.
+  VelocityCommandBuffer cmd_queue_;
+
+  /// \brief Serializes the producers of cmd_queue_.
+  std::mutex vel_push_mutex_;
+
+  /// \brief Mode requested by a ROS callback, picked up by the next update.
+  std::atomic<uint8_t> requested_mode_{kNoModeRequest};
+
+  /// \brief Current mode.
+  ActorMode mode_ = ACTOR_MODE_IDLE;
+
+  /// \brief Whether velocity commands currently preempt the mode.
+  bool preempted_ = false;
+
+  /// \brief Simulation time at which the preempted mode resumes.
+  double preempt_until_ = 0;
+
+  /// \brief Commanded velocities.
+  double linear_ = 0;
+  double angular_ = 0;
+
+  /// \brief Path currently followed.
+  ActorPathPtr path_;
+
+  /// \brief Latest path received, waiting to be picked up by the update
+  /// thread. Only accessed through std::atomic_exchange.
+  ActorPathPtr pending_path_;
+
+  /// \brief Latest path handed over, which incremental updates apply to.
+  /// Only accessed by the ROS callbacks, under path_mutex_.
+  ActorPathPtr latest_path_;
+
+  /// \brief Serializes the ROS callbacks building new paths.
+  std::mutex path_mutex_;
+
+  /// \brief Paths reused by the ROS callbacks, under path_mutex_.
+  ActorPathPool path_pool_;
+
+  /// \brief Index of the current target pose.
+  size_t idx_ = 0;
+
+  /// \brief Arc length of the path reached, when looking ahead.
+  double progress_ = 0;
+
+  /// \brief Whether the path is aborted.
+  std::atomic<bool> abort_{false};
+
+#ifdef ACTOR_DIAGNOSTICS
+  /// \brief Hot path measurements of the actor, null if not measured.
+  ActorDiagnostics *diagnostics_ = nullptr;
+#endif
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_COMMAND_ARBITER
@@ -0,0 +1,100 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_COMMAND_ROUTER
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_COMMAND_ROUTER
+
+#include <gazebo_ros_actor_plugin/ActorCommandArray.h>
+#include <nav_msgs/Path.h>
+#include <ros/ros.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "gazebo_ros_actor_plugin/shared_callback_queue.h"
+
+namespace gazebo {
+
+/// \brief Path of a command of a batched message, sharing ownership of the
+/// message so that its poses are not copied.
+/// \param[in] _msg Received commands.
+/// \param[in] _command Index of the command.
+/// \return Path of the command.
+nav_msgs::Path::ConstPtr CommandPath(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+    size_t _command);
+
+/// \brief Time at which the velocity commands of a batched message apply.
+/// \param[in] _msg Received commands.
+/// \param[in] _lockstep Whether the actors run in lockstep mode.
+/// \return Stamp of the message in lockstep mode, in seconds, zero
+/// otherwise so that the commands apply at the next update.
+double CommandStamp(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+    bool _lockstep);
+
+/// \brief Single subscription to a batched command topic, routing each
+/// command to the actor plugin of the process it names.
+///
+/// Actors register under their name, and each command is handed to its
+/// actor through one lookup in the table of names. Commands to actors that
+/// did not register are ignored, as they may be served by another plugin.
+class ActorCommandRouter {
+ public:
+  /// \brief Handler of the commands to one actor.
+  /// \param[in] _msg Received commands.
+  /// \param[in] _command Index of the command to the actor.
+  using Handler = std::function<void(
+      const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+      size_t _command)>;
+
+  /// \brief Get the router of a topic shared by the actor plugins of the
+  /// process, creating it if needed.
+  /// \param[in] _topic Batched command topic.
+  /// \return Shared pointer to the router.
+  static std::shared_ptr<ActorCommandRouter> Acquire(
+      const std::string &_topic);
+
+  /// \brief Constructor, subscribes to the topic on the shared callback
+  /// queue.
+  /// \param[in] _topic Batched command topic.
+  explicit ActorCommandRouter(const std::string &_topic);
+
+  /// \brief Destructor, unsubscribes from the topic.
+  ~ActorCommandRouter();
+
+  /// \brief Route the commands to an actor to a handler.
+  /// \param[in] _name Name of the actor.
+  /// \param[in] _handler Handler of its commands.
+  void Register(const std::string &_name, Handler _handler);
+
+  /// \brief Stop routing the commands to an actor. Returns once no handler
+  /// of the actor runs anymore.
+  /// \param[in] _name Name of the actor.
+  void Unregister(const std::string &_name);
+
+ private:
+  /// \brief Route the commands of a message.
+  /// \param[in] _msg Received commands.
+  void Callback(
+      const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg);
+
+  /// \brief Queue serving the subscription.
+  std::shared_ptr<SharedCallbackQueue> queue_;
+
+  /// \brief Node handle of the subscription.
+  ros::NodeHandle node_;
+
+  /// \brief Subscriber to the batched commands.
+  ros::Subscriber sub_;
+
+  /// \brief Protect the handlers, registered from the plugins' Load.
+  std::mutex mutex_;
+
+  /// \brief Handler of each registered actor, by name.
+  std::unordered_map<std::string, Handler> handlers_;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_COMMAND_ROUTER
@@ -0,0 +1,131 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_DIAGNOSTICS
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_DIAGNOSTICS
+
+/// \brief Expand to its arguments when the instrumentation is built, to
+/// nothing otherwise, so the hot path pays nothing without it.
+#ifdef ACTOR_DIAGNOSTICS
+#define ACTOR_DIAG(...) __VA_ARGS__
+#else
+#define ACTOR_DIAG(...)
+#endif
+
+#ifdef ACTOR_DIAGNOSTICS
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gazebo {
+
+/// \brief Monotonic wall clock used by the instrumentation.
+/// \return Time in seconds since an arbitrary origin.
+inline double DiagnosticsClock() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// \brief Histogram of durations with power of two buckets, from one
+/// microsecond on. Adding a sample costs a few instructions and no
+/// allocation.
+class LatencyHistogram {
+ public:
+  /// \brief Number of buckets.
+  static constexpr size_t kBuckets = 32;
+
+  /// \brief Add a sample.
+  /// \param[in] _seconds Duration in seconds.
+  void Add(double _seconds);
+
+  /// \brief Number of samples.
+  uint64_t Count() const { return this->count_; }
+
+  /// \brief Mean of the samples, in seconds.
+  double Mean() const;
+
+  /// \brief Largest sample, in seconds.
+  double Max() const { return this->max_; }
+
+  /// \brief Upper bound of the bucket holding a quantile, in seconds.
+  /// \param[in] _q Quantile between 0 and 1.
+  double Quantile(double _q) const;
+
+  /// \brief Drop every sample.
+  void Clear();
+
+ private:
+  /// \brief Number of samples of each bucket. Bucket i holds durations
+  /// below 2^i microseconds.
+  uint64_t buckets_[kBuckets] = {};
+
+  /// \brief Number of samples.
+  uint64_t count_ = 0;
+
+  /// \brief Sum of the samples, in seconds.
+  double sum_ = 0;
+
+  /// \brief Largest sample, in seconds.
+  double max_ = 0;
+};
+
+/// \brief Mean and maximum of a sampled quantity, such as a queue depth.
+struct SampleStats {
+  /// \brief Add a sample.
+  /// \param[in] _value Sampled value.
+  void Add(double _value);
+
+  /// \brief Drop every sample.
+  void Clear() { *this = SampleStats(); }
+
+  /// \brief Number of samples.
+  uint64_t count = 0;
+
+  /// \brief Sum of the samples.
+  double sum = 0;
+
+  /// \brief Largest sample.
+  double max = 0;
+};
+
+/// \brief Hot path measurements of the actors, published as diagnostics
+/// and cleared after each publication.
+struct ActorDiagnostics {
+  /// \brief Time spent updating the actors.
+  LatencyHistogram update;
+
+  /// \brief Time from the reception of a velocity command to its use.
+  LatencyHistogram velocity_latency;
+
+  /// \brief Time from the reception of a path to its pickup.
+  LatencyHistogram path_latency;
+
+  /// \brief Time spent publishing odometry.
+  LatencyHistogram odom_publish;
+
+  /// \brief Number of pending velocity commands at each update.
+  SampleStats queue_depth;
+
+  /// \brief Add the measurements to a status.
+  /// \param[out] _status Status the key values are added to.
+  void Fill(diagnostic_msgs::DiagnosticStatus &_status) const;
+
+  /// \brief Drop every measurement.
+  void Clear();
+};
+
+/// \brief Add the statistics of a histogram to a status, as milliseconds.
+/// \param[in] _name Prefix of the keys.
+/// \param[in] _histogram Histogram to report, skipped if empty.
+/// \param[out] _status Status the key values are added to.
+void AddHistogram(const std::string &_name, const LatencyHistogram &_histogram,
+                  diagnostic_msgs::DiagnosticStatus &_status);
+
+}  // namespace gazebo
+
+#endif  // ACTOR_DIAGNOSTICS
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_DIAGNOSTICS
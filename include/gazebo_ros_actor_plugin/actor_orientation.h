@@ -0,0 +1,84 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_ORIENTATION
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_ORIENTATION
+
+#include <geometry_msgs/Quaternion.h>
+
+#include <ignition/math/Quaternion.hh>
+
+#include <cmath>
+
+namespace gazebo {
+
+/// \brief Yaw of a quaternion, without a full roll-pitch-yaw decomposition
+/// as done by Euler() and Yaw().
+/// \param[in] _q Quaternion.
+/// \return Rotation around the vertical axis.
+inline double QuaternionToYaw(const ignition::math::Quaterniond &_q) {
+  return std::atan2(2.0 * (_q.W() * _q.Z() + _q.X() * _q.Y()),
+                    1.0 - 2.0 * (_q.Y() * _q.Y() + _q.Z() * _q.Z()));
+}
+
+/// \brief Planar yaw of an actor, the authoritative state its rotations
+/// are derived from.
+///
+/// The actor pose is rolled by the default rotation of its skin and then
+/// yawed, and its odometry heading is the yaw minus the default rotation.
+/// The sine and cosine of half the default rotation are taken once, so
+/// setting the yaw costs one sine and one cosine of its half, which both
+/// quaternions reuse, instead of an Euler conversion each.
+class ActorOrientation {
+ public:
+  /// \brief Constructor
+  /// \param[in] _default_rotation Default rotation of the actor skin.
+  explicit ActorOrientation(double _default_rotation = 0)
+      : cos_rot_(std::cos(_default_rotation / 2)),
+        sin_rot_(std::sin(_default_rotation / 2)) {}
+
+  /// \brief Set the yaw of the actor.
+  /// \param[in] _yaw Yaw of the actor pose.
+  void Set(double _yaw) {
+    this->yaw_ = _yaw;
+    this->cos_ = std::cos(_yaw / 2);
+    this->sin_ = std::sin(_yaw / 2);
+  }
+
+  /// \brief Yaw of the actor pose.
+  double Yaw() const { return this->yaw_; }
+
+  /// \brief Rotation of the actor pose, equal to
+  /// Quaterniond(default_rotation, 0, yaw).
+  ignition::math::Quaterniond Rotation() const {
+    return ignition::math::Quaterniond(
+        this->cos_ * this->cos_rot_, this->cos_ * this->sin_rot_,
+        this->sin_ * this->sin_rot_, this->sin_ * this->cos_rot_);
+  }
+
+  /// \brief Heading of the actor in odometry, a rotation about z by the
+  /// yaw minus the default rotation.
+  geometry_msgs::Quaternion Heading() const {
+    geometry_msgs::Quaternion heading;
+    heading.z = this->sin_ * this->cos_rot_ - this->cos_ * this->sin_rot_;
+    heading.w = this->cos_ * this->cos_rot_ + this->sin_ * this->sin_rot_;
+    return heading;
+  }
+
+ private:
+  /// \brief Cosine of half the default rotation.
+  double cos_rot_;
+
+  /// \brief Sine of half the default rotation.
+  double sin_rot_;
+
+  /// \brief Yaw of the actor pose.
+  double yaw_ = 0;
+
+  /// \brief Cosine of half the yaw.
+  double cos_ = 1;
+
+  /// \brief Sine of half the yaw.
+  double sin_ = 0;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_ORIENTATION
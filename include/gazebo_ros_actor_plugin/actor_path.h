@@ -0,0 +1,281 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_PATH
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_PATH
+
+#include <gazebo_ros_actor_plugin/PathUpdate.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/Quaternion.h>
+#include <nav_msgs/Path.h>
+
+#include <ignition/math/Vector3.hh>
+
+#include <boost/shared_ptr.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gazebo_ros_actor_plugin/actor_diagnostics.h"
+
+namespace gazebo {
+
+/// \brief Yaw of a quaternion, without a full roll-pitch-yaw decomposition.
+/// \param[in] _q Quaternion.
+/// \return Rotation around the vertical axis.
+inline double QuaternionToYaw(const geometry_msgs::Quaternion &_q) {
+  return std::atan2(2.0 * (_q.w * _q.z + _q.x * _q.y),
+                    1.0 - 2.0 * (_q.y * _q.y + _q.z * _q.z));
+}
+
+/// \brief Point on a path, between two consecutive poses.
+struct PathPoint {
+  /// \brief Position of the point.
+  double x = 0;
+  double y = 0;
+
+  /// \brief Yaw of the pose at index.
+  double yaw = 0;
+
+  /// \brief Arc length from the first pose of the path to the point.
+  double s = 0;
+
+  /// \brief Index of the first pose at or after the point.
+  size_t index = 0;
+
+  /// \brief Squared distance to the queried position, if any.
+  double distance2 = 0;
+};
+
+class ActorPathPool;
+
+/// \brief Path received from a ROS publisher.
+///
+/// The path is a view on the received messages rather than a copy of their
+/// poses, so a message delivered intra-process is never copied, and an
+/// incremental update only costs the poses it carries. A path is never
+/// modified once it has been handed over to the update thread. Callbacks
+/// build a new one and swap it in atomically.
+///
+/// Every path is indexed when it is built, by the cumulative arc length of
+/// its poses and a uniform grid over the lines joining them. Closest point
+/// and lookahead queries then cost O(log n) instead of a walk through the
+/// whole path.
+struct ActorPath {
+  /// \brief How the update thread chooses the first target when it
+  /// switches to this path.
+  enum Resume : uint8_t {
+    /// \brief Walk to the first pose.
+    RESUME_START,
+    /// \brief Keep the index of the current target.
+    RESUME_KEEP,
+    /// \brief Keep the index of the current target if it is lower than
+    /// resume_index, walk to resume_index otherwise.
+    RESUME_FROM,
+    /// \brief Walk to the pose closest to the actor.
+    RESUME_CLOSEST
+  };
+
+  /// \brief Consecutive poses of the path, read from a message.
+  struct Segment {
+    /// \brief Keeps the memory of the poses alive.
+    boost::shared_ptr<const void> owner;
+
+    /// \brief First pose of the segment.
+    const geometry_msgs::PoseStamped *poses;
+
+    /// \brief Number of poses of the segment.
+    size_t size;
+  };
+
+  /// \brief Create a path made of a single pose.
+  /// \param[in] _x X position of the pose.
+  /// \param[in] _y Y position of the pose.
+  /// \param[in] _yaw Yaw of the pose.
+  static std::shared_ptr<ActorPath> FromPose(double _x, double _y,
+                                             double _yaw);
+
+  /// \brief Create a path walking all poses of a message.
+  /// \param[in] _msg Received path.
+  /// \param[in] _pool Pool the path is taken from, null to allocate it.
+  static std::shared_ptr<ActorPath> FromMessage(
+      const nav_msgs::Path::ConstPtr &_msg, ActorPathPool *_pool = nullptr);
+
+  /// \brief Create a path by applying an incremental update.
+  /// \param[in] _base Path the update applies to, may be null.
+  /// \param[in] _msg Received update.
+  /// \param[in] _pool Pool the path is taken from, null to allocate it.
+  static std::shared_ptr<ActorPath> FromUpdate(
+      const std::shared_ptr<const ActorPath> &_base,
+      const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &_msg,
+      ActorPathPool *_pool = nullptr);
+
+  /// \brief Empty the path, keeping the memory of its index for the next
+  /// path built in it.
+  void Clear();
+
+  /// \brief Number of poses of the path.
+  size_t Size() const { return this->ends.empty() ? 0 : this->ends.back(); }
+
+  /// \brief Whether the path has no pose.
+  bool Empty() const { return this->Size() == 0; }
+
+  /// \brief Target pose at the given index, as (x, y, yaw).
+  /// \param[in] _idx Index of the pose, must be lower than Size().
+  ignition::math::Vector3d At(size_t _idx) const;
+
+  /// \brief Position of the pose at the given index.
+  /// \param[in] _idx Index of the pose, must be lower than Size().
+  const geometry_msgs::Point &Position(size_t _idx) const;
+
+  /// \brief Length of the path.
+  double Length() const { return this->arc.empty() ? 0 : this->arc.back(); }
+
+  /// \brief Arc length from the first pose to the pose at the given index.
+  /// \param[in] _idx Index of the pose, must be lower than Size().
+  double ArcLength(size_t _idx) const { return this->arc[_idx]; }
+
+  /// \brief Point of the path at the given arc length.
+  /// \param[in] _s Arc length, clamped to the length of the path.
+  /// \return Point of the path, the path must not be empty.
+  PathPoint AtArcLength(double _s) const;
+
+  /// \brief Point of the whole path closest to a position, found with
+  /// the grid.
+  /// \param[in] _x X position.
+  /// \param[in] _y Y position.
+  /// \return Closest point, the path must not be empty.
+  PathPoint ClosestPoint(double _x, double _y) const;
+
+  /// \brief Point closest to a position within an arc length interval.
+  /// Cheaper than ClosestPoint() when the interval is short, and never
+  /// jumps to another part of the path that passes nearby.
+  /// \param[in] _x X position.
+  /// \param[in] _y Y position.
+  /// \param[in] _s_min Start of the interval.
+  /// \param[in] _s_max End of the interval.
+  /// \return Closest point, the path must not be empty.
+  PathPoint Project(double _x, double _y, double _s_min, double _s_max) const;
+
+  /// \brief Pure pursuit target: advance the progress of an actor along the
+  /// path, then look ahead of it.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \param[in] _lookahead Lookahead distance along the path.
+  /// \param[in,out] _progress Arc length reached by the actor, which
+  /// never decreases.
+  /// \return Point to steer to, the path must not be empty.
+  PathPoint Lookahead(double _x, double _y, double _lookahead,
+                      double &_progress) const;
+
+  /// \brief Index of the first target when switching to this path.
+  /// \param[in] _idx Index of the target on the previous path.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  size_t ResumeIndex(size_t _idx, double _x, double _y) const;
+
+  /// \brief Take over how to resume from a path that was replaced by this
+  /// one before the update thread picked it up.
+  /// \param[in] _skipped Path that was never followed.
+  void MergeResume(const ActorPath &_skipped);
+
+  /// \brief Append poses of a message at the end of the path.
+  /// \param[in] _owner Message holding the poses.
+  /// \param[in] _poses First pose to append.
+  /// \param[in] _size Number of poses to append.
+  void Append(const boost::shared_ptr<const void> &_owner,
+              const geometry_msgs::PoseStamped *_poses, size_t _size);
+
+  /// \brief Compute the arc lengths and the grid of the path.
+  /// \param[in] _base Path sharing its first poses with this one, may be
+  /// null.
+  /// \param[in] _shared Number of poses shared with the base path.
+  void BuildIndex(const ActorPath *_base, size_t _shared);
+
+  /// \brief Segments the poses are read from.
+  std::vector<Segment> segments;
+
+  /// \brief Index one past the last pose of each segment.
+  std::vector<size_t> ends;
+
+  /// \brief Cumulative arc length at each pose.
+  std::vector<double> arc;
+
+  /// \brief Uniform grid over the lines joining consecutive poses. Line i
+  /// joins poses i and i + 1. The lines crossing cell c are
+  /// lines[start[c]] up to lines[start[c + 1]], with c = cy * nx + cx.
+  struct Grid {
+    /// \brief Lower corner of the grid.
+    double min_x = 0;
+    double min_y = 0;
+
+    /// \brief Side of a cell.
+    double cell = 1;
+
+    /// \brief Number of cells along x and y.
+    size_t nx = 0;
+    size_t ny = 0;
+
+    /// \brief Offset of the lines of each cell, one past the end last.
+    std::vector<uint32_t> start;
+
+    /// \brief Lines of every cell, cell after cell.
+    std::vector<uint32_t> lines;
+  } grid;
+
+  /// \brief How to choose the first target.
+  Resume resume = RESUME_START;
+
+  /// \brief Index used by RESUME_FROM.
+  size_t resume_index = 0;
+
+  /// \brief Time stamp of the message the path was built from, in seconds.
+  double stamp = 0;
+
+  /// \brief Wall time of the reception of the message, zero if unknown.
+  ACTOR_DIAG(double received = 0;)
+};
+
+/// \brief Shared pointer to an immutable path.
+typedef std::shared_ptr<const ActorPath> ActorPathPtr;
+
+/// \brief Paths of one actor kept for reuse, so that replanning does not
+/// allocate once the pool is warm.
+///
+/// A path of the pool is reused once nobody else references it anymore,
+/// like ReusableMessage, with the capacity of its arc lengths, grid and
+/// segments. A pool is only used by the callbacks of its actor, which are
+/// serialized by its path mutex.
+class ActorPathPool {
+ public:
+  /// \brief Number of paths kept: the one followed, the one waiting to be
+  /// picked up, the one being built and a few held by predictions or
+  /// released late.
+  static constexpr size_t kSize = 6;
+
+  /// \brief Get an empty path, reused from the pool when possible.
+  /// \return Path only referenced by the pool and the caller.
+  std::shared_ptr<ActorPath> Acquire();
+
+ private:
+  /// \brief Paths of the pool.
+  std::vector<std::shared_ptr<ActorPath>> paths_;
+};
+
+/// \brief Take the path handed over by a ROS callback, if any.
+/// \param[in,out] _pending Slot the callbacks store new paths in, only
+/// accessed atomically.
+/// \param[in] _now Current simulation time, in seconds. A path stamped
+/// later is left in the slot. Negative to take any path.
+/// \return Path taken from the slot, null if none.
+ActorPathPtr TakePendingPath(ActorPathPtr &_pending, double _now);
+
+/// \brief Parse how full paths are resumed from its SDF name.
+/// \param[in] _name One of "start" or "closest".
+/// \param[out] _resume ActorPath::RESUME_START or ActorPath::RESUME_CLOSEST.
+/// \return False if the name is unknown.
+bool ParsePathResume(const std::string &_name, ActorPath::Resume &_resume);
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_PATH
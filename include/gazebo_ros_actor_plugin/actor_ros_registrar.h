@@ -0,0 +1,85 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_ROS_REGISTRAR
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_ROS_REGISTRAR
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief Threads registering the ROS topics and services of the actor
+/// plugins with the master, shared by every plugin of the process.
+///
+/// Each subscription, publication and service costs a round trip to the
+/// master. Plugins queue their registration here instead of doing it in
+/// Load, so the world loads and steps without waiting for the master, and
+/// the round trips of several plugins overlap. A plugin ignores its ROS
+/// interfaces until its registration has run.
+class ActorRosRegistrar {
+ public:
+  /// \brief Registration of a plugin.
+  using Job = std::function<void()>;
+
+  /// \brief Get the registrar shared by the plugins of the process,
+  /// creating it if needed.
+  /// \param[in] _threads Number of registration threads, only used by the
+  /// call that creates the registrar.
+  /// \return Shared pointer to the registrar.
+  static std::shared_ptr<ActorRosRegistrar> Acquire(unsigned int _threads);
+
+  /// \brief Constructor
+  /// \param[in] _threads Number of registration threads, at least one.
+  explicit ActorRosRegistrar(unsigned int _threads);
+
+  /// \brief Destructor, drops the registrations not started yet and joins
+  /// the threads.
+  ~ActorRosRegistrar();
+
+  ActorRosRegistrar(const ActorRosRegistrar &) = delete;
+  ActorRosRegistrar &operator=(const ActorRosRegistrar &) = delete;
+
+  /// \brief Queue a registration, started in the order of the calls.
+  /// \param[in] _owner Plugin the registration belongs to.
+  /// \param[in] _job Registration.
+  void Add(const void *_owner, Job _job);
+
+  /// \brief Drop the registrations of a plugin not started yet. Returns
+  /// once none of them runs anymore.
+  /// \param[in] _owner Plugin given to Add().
+  void Cancel(const void *_owner);
+
+ private:
+  /// \brief Loop of a registration thread.
+  void Work();
+
+  /// \brief Registration threads.
+  std::vector<std::thread> workers_;
+
+  /// \brief Guards the queue and the running registrations.
+  std::mutex mutex_;
+
+  /// \brief Wakes the threads when a registration is queued or the
+  /// registrar stops.
+  std::condition_variable wake_;
+
+  /// \brief Wakes Cancel() when a registration ends.
+  std::condition_variable done_;
+
+  /// \brief Registrations not started yet, with their plugin.
+  std::deque<std::pair<const void *, Job>> jobs_;
+
+  /// \brief Plugin of each running registration.
+  std::vector<const void *> running_;
+
+  /// \brief Whether the threads exit.
+  bool stop_ = false;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_ROS_REGISTRAR
@@ -0,0 +1,250 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_STATE_STORE
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_STATE_STORE
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief Motion mode of an actor inside the state store.
+enum ActorMode : uint8_t {
+  /// \brief Actor does not move.
+  ACTOR_MODE_IDLE = 0,
+  /// \brief Actor integrates its commanded linear and angular velocity.
+  ACTOR_MODE_VELOCITY = 1,
+  /// \brief Actor walks towards its current target position.
+  ACTOR_MODE_PATH = 2,
+  /// \brief Actor plays the trajectory of its SDF script.
+  ACTOR_MODE_SCRIPTED = 3,
+  /// \brief Actor replays its trajectory from a recording.
+  ACTOR_MODE_REPLAY = 4
+};
+
+/// \brief Parse an actor mode from its name.
+/// \param[in] _name One of "idle", "velocity", "path", "scripted" or
+/// "replay".
+/// \param[out] _mode Parsed mode.
+/// \return False if the name is unknown.
+bool ParseActorMode(const std::string &_name, ActorMode &_mode);
+
+/// \brief Name of an actor mode.
+/// \param[in] _mode Actor mode.
+const char *ActorModeName(ActorMode _mode);
+
+/// \brief Wrap an angle to [-pi, pi].
+/// \param[in] _angle Angle, in radians, of any magnitude.
+inline double WrapAngle(double _angle) {
+  return std::remainder(_angle, 2.0 * M_PI);
+}
+
+/// \brief Skeleton animation played by an actor.
+enum ActorAnimation : uint8_t {
+  /// \brief Standing still.
+  ANIMATION_STANDING = 0,
+  /// \brief Walking, advanced with the distance travelled.
+  ANIMATION_WALKING = 1
+};
+
+/// \brief Parameters shared by every actor updated by the kernel.
+struct ActorKernelParams {
+  /// \brief Speed at which actors move along path during path-following
+  double lin_velocity = 1;
+
+  /// \brief Speed at which actors rotate during rotational alignment
+  double ang_velocity = 0;
+
+  /// \brief Maximum allowable difference in orientation between
+  /// actor's current and desired orientation during rotational alignment
+  double ang_tolerance = 0;
+
+  /// \brief Default rotation of the actor skins
+  double default_rotation = 0;
+};
+
+/// \brief Motion of a single actor over one update cycle.
+struct ActorStep {
+  /// \brief Pose reached at the end of the update, with the yaw wrapped
+  /// to [-pi, pi).
+  double x;
+  double y;
+  double yaw;
+
+  /// \brief Twist during the update, in the world frame.
+  double vx;
+  double vy;
+  double wz;
+};
+
+/// \brief Struct-of-arrays kinematic state of a group of actors.
+///
+/// Every array holds one entry per actor, so the update kernel walks
+/// contiguous memory and can be vectorized by the compiler.
+struct ActorStateStore {
+  /// \brief Add an actor standing at the given pose.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \param[in] _z Z position of the actor.
+  /// \param[in] _yaw Yaw of the actor.
+  /// \return Index of the new actor.
+  size_t Add(double _x, double _y, double _z, double _yaw);
+
+  /// \brief Number of actors in the store.
+  size_t Size() const { return this->x.size(); }
+
+  /// \brief Stop an actor and make it target its current pose.
+  /// \param[in] _idx Index of the actor.
+  void Stop(size_t _idx);
+
+  /// \brief Pose of an actor part of the way through the last kernel run.
+  /// \param[in] _idx Index of the actor.
+  /// \param[in] _alpha Fraction of the kernel time step, from 0 to 1.
+  /// \return Interpolated pose, with the twist of the kernel run.
+  ActorStep Interpolate(size_t _idx, double _alpha) const;
+
+  /// \brief Whether an actor stood still during the last kernel run.
+  /// \param[in] _idx Index of the actor.
+  bool Still(size_t _idx) const;
+
+  /// \brief Current pose of the actors.
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+  std::vector<double> yaw;
+
+  /// \brief Commanded linear and angular velocity in velocity mode.
+  std::vector<double> v;
+  std::vector<double> w;
+
+  /// \brief Current target pose in path mode.
+  std::vector<double> target_x;
+  std::vector<double> target_y;
+  std::vector<double> target_yaw;
+
+  /// \brief Whether the actor has a target to walk to in path mode.
+  std::vector<uint8_t> has_target;
+
+  /// \brief ActorMode of each actor.
+  std::vector<uint8_t> mode;
+
+  /// \brief Twist produced by the last kernel run, in the world frame.
+  std::vector<double> vel_x;
+  std::vector<double> vel_y;
+  std::vector<double> vel_yaw;
+
+  /// \brief Planar distance travelled during the last kernel run.
+  std::vector<double> travelled;
+
+  /// \brief Pose of the actors at the start of the last kernel run.
+  std::vector<double> start_x;
+  std::vector<double> start_y;
+  std::vector<double> start_yaw;
+};
+
+/// \brief Pose part of the way through a step, on the straight line
+/// between its start and end poses.
+/// \param[in] _from Pose at the start of the step.
+/// \param[in] _to Pose at the end of the step, and its twist.
+/// \param[in] _alpha Fraction of the step, from 0 to 1.
+/// \return Interpolated pose, with the twist of the step.
+ActorStep InterpolateStep(const ActorStep &_from, const ActorStep &_to,
+                          double _alpha);
+
+/// \brief Whether an actor stands still during a step, ending where it
+/// started with no twist.
+/// \param[in] _from Pose at the start of the step.
+/// \param[in] _to Pose at the end of the step, and its twist.
+bool IsStill(const ActorStep &_from, const ActorStep &_to);
+
+/// \brief Advance a single actor towards a target with the motion model of
+/// the path mode: rotate in place until facing it, then walk to it. The
+/// turn is bounded by the angular velocity and the walk by the distance to
+/// the target, so long time steps do not overshoot either.
+/// \param[in] _x X position of the actor.
+/// \param[in] _y Y position of the actor.
+/// \param[in] _yaw Yaw of the actor, including the default rotation.
+/// \param[in] _tx X position of the target, the actor position to stand.
+/// \param[in] _ty Y position of the target, the actor position to stand.
+/// \param[in] _params Motion parameters.
+/// \param[in] _dt Time delta since the last update.
+/// \return Motion of the actor.
+ActorStep StepTowards(double _x, double _y, double _yaw, double _tx,
+                      double _ty, const ActorKernelParams &_params,
+                      double _dt);
+
+/// \brief Advance a single actor with the motion model of the velocity
+/// mode: move along its heading and turn at the given rates. The actor
+/// follows the arc of constant velocities exactly, for any time step.
+/// \param[in] _x X position of the actor.
+/// \param[in] _y Y position of the actor.
+/// \param[in] _yaw Yaw of the actor, including the default rotation.
+/// \param[in] _v Linear velocity along the heading.
+/// \param[in] _w Angular velocity.
+/// \param[in] _params Motion parameters.
+/// \param[in] _dt Time delta since the last update.
+/// \return Motion of the actor.
+ActorStep StepVelocity(double _x, double _y, double _yaw, double _v,
+                       double _w, const ActorKernelParams &_params,
+                       double _dt);
+
+/// \brief Advance every actor of the store by one update cycle, with the
+/// motion models of StepTowards and StepVelocity.
+/// \param[in,out] _store State of the actors.
+/// \param[in] _params Parameters shared by all actors.
+/// \param[in] _dt Time delta since the last update.
+void UpdateActorStates(ActorStateStore &_store,
+                       const ActorKernelParams &_params, double _dt);
+
+/// \brief Advance a range of the actors of the store by one update cycle,
+/// so that distinct ranges can be advanced by concurrent threads.
+/// \param[in,out] _store State of the actors.
+/// \param[in] _params Parameters shared by all actors.
+/// \param[in] _dt Time delta since the last update.
+/// \param[in] _begin Index of the first actor of the range.
+/// \param[in] _end Index past the last actor of the range.
+void UpdateActorStates(ActorStateStore &_store,
+                       const ActorKernelParams &_params, double _dt,
+                       size_t _begin, size_t _end);
+
+/// \brief Schedule of the controllers of actors running at a fixed control
+/// rate, decoupled from the physics rate.
+///
+/// At each control tick the controllers advance the actors by a whole
+/// control period, to where they should be at the next tick, and the
+/// updates in between interpolate the pose along that step.
+class ControlClock {
+ public:
+  /// \brief Set the control rate.
+  /// \param[in] _rate Control rate in Hz, 0 to run the controllers every
+  /// update.
+  void Configure(double _rate);
+
+  /// \brief Check whether the controllers run at this update.
+  /// \param[in] _now Simulation time of the update, in seconds.
+  /// \param[in] _dt Time delta since the last update.
+  /// \param[out] _control_dt Time step the controllers advance by.
+  /// \return True on a control tick.
+  bool Tick(double _now, double _dt, double &_control_dt);
+
+  /// \brief Fraction of the current control period elapsed at an update,
+  /// always 1 when the controllers run every update.
+  /// \param[in] _now Simulation time of the update, in seconds.
+  double Alpha(double _now) const;
+
+  /// \brief Simulation time at which the current control step ends, the
+  /// time of the last tick when the controllers run every update.
+  double End() const { return this->start_ + this->period_; }
+
+ private:
+  /// \brief Control period in seconds, 0 for every update.
+  double period_ = 0;
+
+  /// \brief Start of the current control period, in seconds.
+  double start_ = -1;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_STATE_STORE
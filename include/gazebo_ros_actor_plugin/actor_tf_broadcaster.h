@@ -0,0 +1,86 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_TF_BROADCASTER
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_TF_BROADCASTER
+
+#include <geometry_msgs/Quaternion.h>
+#include <ros/ros.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include <memory>
+#include <string>
+
+#include "gazebo/common/Events.hh"
+
+namespace gazebo {
+
+/// \brief Broadcaster of the frames of every actor of the process, in a
+/// single tf2_msgs/TFMessage per update.
+///
+/// During an update each actor plugin adds the transform of its actors,
+/// and the batch is published at the end of the update. The decision to
+/// broadcast is taken once per update, so either every actor is in the
+/// batch or none is. The broadcaster is only used from the physics thread.
+class ActorTfBroadcaster {
+ public:
+  /// \brief Get the broadcaster shared by the plugins of the process,
+  /// creating it if needed.
+  /// \param[in] _rate Rate of the broadcasts in Hz, 0 for every update,
+  /// only used by the call that creates the broadcaster.
+  /// \return Shared pointer to the broadcaster.
+  static std::shared_ptr<ActorTfBroadcaster> Acquire(double _rate);
+
+  /// \brief Constructor, advertises /tf and publishes the batches at the
+  /// end of each update.
+  /// \param[in] _rate Rate of the broadcasts in Hz, 0 for every update.
+  explicit ActorTfBroadcaster(double _rate);
+
+  /// \brief Check whether the frames are broadcast at this update.
+  /// \param[in] _now Simulation time of the update.
+  /// \return False while nobody is subscribed to /tf.
+  bool Due(double _now);
+
+  /// \brief Add the transform of an actor to the batch of this update.
+  /// \param[in] _parent Frame of the odometry of the actor.
+  /// \param[in] _child Frame of the actor.
+  /// \param[in] _stamp Time stamp of the transform.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \param[in] _rotation Heading of the actor.
+  void Add(const std::string &_parent, const std::string &_child,
+           const ros::Time &_stamp, double _x, double _y,
+           const geometry_msgs::Quaternion &_rotation);
+
+ private:
+  /// \brief Publish the batch of the update, if any.
+  void Flush();
+
+  /// \brief Rate of the broadcasts in Hz, 0 for every update.
+  double rate_;
+
+  /// \brief Simulation time Due() was last evaluated at.
+  double checked_ = -1;
+
+  /// \brief Whether the frames are broadcast at checked_.
+  bool due_ = false;
+
+  /// \brief Simulation time of the last broadcast.
+  double last_ = -1;
+
+  /// \brief Node handle of the publisher.
+  ros::NodeHandle node_;
+
+  /// \brief Publisher of the batches.
+  ros::Publisher pub_;
+
+  /// \brief Batch being filled, reused when possible.
+  tf2_msgs::TFMessage::Ptr msg_;
+
+  /// \brief Number of transforms in the batch being filled.
+  size_t count_ = 0;
+
+  /// \brief Connection to the end of the world updates.
+  event::ConnectionPtr connection_;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_TF_BROADCASTER
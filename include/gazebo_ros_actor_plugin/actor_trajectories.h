@@ -0,0 +1,57 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_TRAJECTORIES
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_TRAJECTORIES
+
+#include <array>
+#include <string>
+
+#include "gazebo/physics/physics.hh"
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+
+namespace gazebo {
+
+/// \brief Names of the skeleton animations of the actor skins.
+struct AnimationNames {
+  /// \brief Animation played while walking.
+  std::string walking = "walking";
+
+  /// \brief Animation played while standing.
+  std::string standing = "standing";
+};
+
+/// \brief Read the animation names of a plugin.
+/// \param[in] _sdf Pointer to the plugin's SDF elements.
+/// \param[in,out] _names Names, left unchanged when not set.
+void LoadAnimationNames(const sdf::ElementPtr &_sdf, AnimationNames &_names);
+
+/// \brief Custom trajectories of an actor, one per animation.
+///
+/// The animations are looked up once, when the actor is loaded, and each
+/// gets its own trajectory. Switching animation then hands the actor
+/// another trajectory instead of writing the name of the animation into
+/// its trajectory.
+class ActorTrajectories {
+ public:
+  /// \brief Look up the animations in the skin of an actor and create
+  /// their trajectories.
+  /// \param[in] _actor Actor.
+  /// \param[in] _names Names of the animations.
+  /// \return False, with an error printed, if an animation is missing.
+  bool Resolve(const physics::ActorPtr &_actor, const AnimationNames &_names);
+
+  /// \brief Whether every animation was found.
+  bool Valid() const { return static_cast<bool>(this->trajectories_[0]); }
+
+  /// \brief Trajectory of an animation, only valid when Valid() is true.
+  /// \param[in] _animation Animation.
+  physics::TrajectoryInfoPtr &Get(ActorAnimation _animation) {
+    return this->trajectories_[_animation];
+  }
+
+ private:
+  /// \brief Trajectory of each animation, indexed by ActorAnimation.
+  std::array<physics::TrajectoryInfoPtr, 2> trajectories_;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_TRAJECTORIES
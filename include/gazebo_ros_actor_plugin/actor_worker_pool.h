@@ -0,0 +1,111 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_WORKER_POOL
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_WORKER_POOL
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief Threads splitting a loop over the actors of an update between
+/// the cores, with the calling thread taking part.
+///
+/// The range is cut into chunks the threads claim one after the other
+/// until none is left, so a thread slowed down by costly actors takes
+/// fewer chunks. The workers sleep between loops, and a loop of a single
+/// chunk runs on the calling thread alone.
+class ActorWorkerPool {
+ public:
+  /// \brief Constructor
+  /// \param[in] _threads Number of threads running a loop, the calling
+  /// thread included, 0 for one per core.
+  explicit ActorWorkerPool(unsigned int _threads);
+
+  /// \brief Destructor, joins the workers.
+  ~ActorWorkerPool();
+
+  ActorWorkerPool(const ActorWorkerPool &) = delete;
+  ActorWorkerPool &operator=(const ActorWorkerPool &) = delete;
+
+  /// \brief Number of threads running a loop, the calling thread included.
+  unsigned int Threads() const { return this->workers_.size() + 1; }
+
+  /// \brief Call a function on chunks covering a range, and return once
+  /// they have all been processed. Calls on distinct chunks may run
+  /// concurrently.
+  /// \param[in] _n Size of the range starting at 0.
+  /// \param[in] _grain Size of a chunk, the last one may be shorter.
+  /// \param[in] _f Function called with the begin and end of each chunk.
+  template <typename F>
+  void ParallelFor(size_t _n, size_t _grain, F &&_f) {
+    _grain = std::max<size_t>(_grain, 1);
+    if (this->workers_.empty() || _n <= _grain) {
+      if (_n > 0) _f(size_t(0), _n);
+      return;
+    }
+    using Function = std::remove_reference_t<F>;
+    this->Run(
+        _n, _grain,
+        [](void *_ctx, size_t _begin, size_t _end) {
+          (*static_cast<Function *>(_ctx))(_begin, _end);
+        },
+        const_cast<void *>(static_cast<const void *>(&_f)));
+  }
+
+ private:
+  /// \brief Function processing a chunk, with the context it was given.
+  using Task = void (*)(void *, size_t, size_t);
+
+  /// \brief Hand a loop to the workers and take part in it.
+  /// \param[in] _n Size of the range.
+  /// \param[in] _grain Size of a chunk.
+  /// \param[in] _task Function processing a chunk.
+  /// \param[in] _ctx Context of the function.
+  void Run(size_t _n, size_t _grain, Task _task, void *_ctx);
+
+  /// \brief Process chunks of the current loop until none is left.
+  void Drain();
+
+  /// \brief Loop of a worker thread.
+  void Work();
+
+  /// \brief Worker threads.
+  std::vector<std::thread> workers_;
+
+  /// \brief Guards the loop handed to the workers.
+  std::mutex mutex_;
+
+  /// \brief Wakes the workers when a loop starts or the pool stops.
+  std::condition_variable wake_;
+
+  /// \brief Wakes the calling thread when the workers are done.
+  std::condition_variable done_;
+
+  /// \brief Number of the current loop, telling the workers a new one.
+  uint64_t generation_ = 0;
+
+  /// \brief Number of workers not done with the current loop.
+  size_t busy_ = 0;
+
+  /// \brief Whether the workers exit.
+  bool stop_ = false;
+
+  /// \brief Current loop.
+  Task task_ = nullptr;
+  void *ctx_ = nullptr;
+  size_t n_ = 0;
+  size_t grain_ = 1;
+
+  /// \brief Start of the next unclaimed chunk.
+  std::atomic<size_t> next_{0};
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ACTOR_WORKER_POOL
@@ -0,0 +1,146 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ANIMATION_LOD
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ANIMATION_LOD
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <ignition/math/Vector3.hh>
+#include "gazebo/msgs/msgs.hh"
+#include "gazebo/physics/physics.hh"
+#include "gazebo/transport/transport.hh"
+
+namespace gazebo {
+
+/// \brief Parameters of the animation level of detail.
+struct AnimationLodParams {
+  /// \brief Distance to the reference beyond which the skeleton of an actor
+  /// is refreshed at a lower rate, 0 disables the level of detail.
+  double distance = 0;
+
+  /// \brief Rate at which the skeleton of a distant actor is refreshed,
+  /// 0 freezes it.
+  double rate = 5;
+
+  /// \brief Name of the model or link the distance is measured from, or
+  /// AnimationLodReference::kUserCamera for the camera of gzclient.
+  std::string reference = "user_camera";
+};
+
+/// \brief Read the animation level of detail parameters of a plugin.
+/// \param[in] _sdf Pointer to the plugin's SDF elements.
+/// \param[in,out] _params Parameters, left unchanged when not set.
+void LoadAnimationLodParams(const sdf::ElementPtr &_sdf,
+                            AnimationLodParams &_params);
+
+/// \brief Position the animation level of detail of the actors is measured
+/// from, a model or link of the world or the camera of gzclient.
+class AnimationLodReference {
+ public:
+  /// \brief Reference name following the camera of gzclient.
+  static constexpr const char *kUserCamera = "user_camera";
+
+  /// \brief Get the reference of a name shared by the plugins of the
+  /// process, creating it if needed. Shared references are only read from
+  /// the physics thread.
+  /// \param[in] _world Pointer to the world.
+  /// \param[in] _name Name of the model or link, or kUserCamera.
+  /// \return Shared pointer to the reference.
+  static std::shared_ptr<AnimationLodReference> Acquire(
+      const physics::WorldPtr &_world, const std::string &_name);
+
+  /// \brief Constructor
+  /// \param[in] _world Pointer to the world.
+  /// \param[in] _name Name of the model or link, or kUserCamera.
+  AnimationLodReference(const physics::WorldPtr &_world,
+                        const std::string &_name);
+
+  /// \brief Position of the reference, read once per update.
+  /// \param[in] _now Simulation time of the update.
+  /// \param[out] _position Position of the reference.
+  /// \return False while the entity does not exist or no camera pose has
+  /// been received.
+  bool Position(double _now, ignition::math::Vector3d &_position);
+
+ private:
+  /// \brief Receive the pose of the camera of gzclient.
+  /// \param[in] _msg Camera pose.
+  void OnCameraPose(ConstPosePtr &_msg);
+
+  /// \brief Pointer to the world.
+  physics::WorldPtr world_;
+
+  /// \brief Name of the model or link.
+  std::string name_;
+
+  /// \brief Entity of the name, looked up again at most once per second so
+  /// that a reference spawned or removed later is followed.
+  physics::EntityPtr entity_;
+
+  /// \brief Simulation time of the next lookup of the entity.
+  double next_lookup_ = -1;
+
+  /// \brief Simulation time the position was last read at.
+  double read_time_ = -1;
+
+  /// \brief Whether the position is known.
+  bool valid_ = false;
+
+  /// \brief Position read at read_time_.
+  ignition::math::Vector3d position_;
+
+  /// \brief Gazebo transport node of the camera subscription.
+  transport::NodePtr node_;
+
+  /// \brief Subscriber to the camera pose of gzclient.
+  transport::SubscriberPtr camera_sub_;
+
+  /// \brief Protect the camera pose, received on a transport thread.
+  std::mutex camera_mutex_;
+
+  /// \brief Whether a camera pose has been received.
+  bool has_camera_ = false;
+
+  /// \brief Latest camera position.
+  ignition::math::Vector3d camera_;
+};
+
+/// \brief Level of detail of the skeleton animation of an actor.
+///
+/// Gazebo evaluates the skeleton of an active actor up to 30 times per
+/// second of simulation, which is most of the cost of an actor. Beyond the
+/// distance of the parameters the actor is stopped, so that Gazebo skips
+/// the skeleton, and only played at the updates where its skeleton is due
+/// for a refresh. The root pose and the script time are still set at every
+/// update, so a refreshed skeleton is at the phase of the walk matching the
+/// distance travelled.
+class AnimationLod {
+ public:
+  /// \brief Decide whether the skeleton of an actor following a custom
+  /// trajectory is animated at this update, and play or stop it.
+  /// \param[in] _actor Actor.
+  /// \param[in] _params Level of detail parameters.
+  /// \param[in] _far Whether the actor is beyond the distance.
+  /// \param[in] _now Simulation time of the update.
+  /// \return Whether the skeleton is animated. A frozen skeleton no longer
+  /// carries the root pose to rendering, which must then be published with
+  /// it.
+  bool Update(physics::Actor &_actor, const AnimationLodParams &_params,
+              bool _far, double _now);
+
+  /// \brief Play an actor the level of detail stopped, before it leaves
+  /// the custom trajectory.
+  /// \param[in] _actor Actor.
+  void Resume(physics::Actor &_actor);
+
+ private:
+  /// \brief Whether the actor is stopped by the level of detail.
+  bool stopped_ = false;
+
+  /// \brief Simulation time of the last refresh of the skeleton.
+  double refresh_ = -1;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_ANIMATION_LOD
@@ -0,0 +1,26 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_AVOIDANCE_WORLD
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_AVOIDANCE_WORLD
+
+#include <vector>
+
+#include "gazebo/physics/physics.hh"
+#include "gazebo_ros_actor_plugin/crowd_avoidance.h"
+
+namespace gazebo {
+
+/// \brief Read the avoidance parameters of a plugin.
+/// \param[in] _sdf Pointer to the plugin's SDF elements.
+/// \param[in,out] _params Parameters, left unchanged when not set.
+void LoadAvoidanceParams(const sdf::ElementPtr &_sdf,
+                         AvoidanceParams &_params);
+
+/// \brief Footprints of the links of every static model of the world that
+/// an actor could bump into, leaving out actors and the ground.
+/// \param[in] _world Pointer to the world.
+/// \return Footprints of the obstacles.
+std::vector<ObstacleFootprint> StaticObstacleFootprints(
+    const physics::WorldPtr &_world);
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_AVOIDANCE_WORLD
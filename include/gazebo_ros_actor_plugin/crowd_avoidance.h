@@ -0,0 +1,265 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_CROWD_AVOIDANCE
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_CROWD_AVOIDANCE
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+#include "gazebo_ros_actor_plugin/actor_worker_pool.h"
+
+namespace gazebo {
+
+/// \brief Parameters of the social force avoidance.
+struct AvoidanceParams {
+  /// \brief Radius of an actor.
+  double radius = 0.3;
+
+  /// \brief Distance beyond which actors and obstacles are ignored.
+  double range = 1.5;
+
+  /// \brief Repulsion speed between two actors in contact.
+  double strength = 1.0;
+
+  /// \brief Distance over which the repulsion decays by a factor e.
+  double falloff = 0.3;
+
+  /// \brief Repulsion speed of an obstacle in contact.
+  double obstacle_strength = 1.0;
+
+  /// \brief Side of the cells of the static occupancy grid.
+  double resolution = 0.1;
+};
+
+/// \brief Axis aligned footprint of a static obstacle.
+struct ObstacleFootprint {
+  /// \brief Lower corner.
+  double min_x;
+  double min_y;
+
+  /// \brief Upper corner.
+  double max_x;
+  double max_y;
+};
+
+/// \brief Static obstacles of the world rasterized on a 2D grid, with the
+/// nearest obstacle of every cell precomputed so a query costs O(1).
+class ObstacleMap {
+ public:
+  /// \brief Rasterize obstacles.
+  /// \param[in] _boxes Footprints of the obstacles.
+  /// \param[in] _resolution Side of a cell.
+  /// \param[in] _margin Distance around the obstacles covered by the map.
+  void Build(const std::vector<ObstacleFootprint> &_boxes,
+             double _resolution, double _margin);
+
+  /// \brief Whether the map has no obstacle.
+  bool Empty() const { return this->nearest_.empty(); }
+
+  /// \brief Nearest obstacle to a position.
+  /// \param[in] _x X position.
+  /// \param[in] _y Y position.
+  /// \param[out] _dx X component of the unit vector pointing away from the
+  /// obstacle.
+  /// \param[out] _dy Y component of the unit vector pointing away from the
+  /// obstacle.
+  /// \param[out] _dist Distance to the obstacle.
+  /// \return False if no obstacle is within the margin of the map.
+  bool Nearest(double _x, double _y, double &_dx, double &_dy,
+               double &_dist) const;
+
+ private:
+  /// \brief Lower corner of the map.
+  double min_x_ = 0;
+  double min_y_ = 0;
+
+  /// \brief Side of a cell.
+  double resolution_ = 1;
+
+  /// \brief Number of cells along x and y.
+  int nx_ = 0;
+  int ny_ = 0;
+
+  /// \brief Index of the nearest occupied cell of each cell, -1 if none.
+  std::vector<int32_t> nearest_;
+};
+
+/// \brief Uniform grid of actor positions, hashed into a table sized after
+/// the number of actors, so building it and querying the neighbors of
+/// every actor is O(N).
+class SpatialHash {
+ public:
+  /// \brief Sort positions into the grid.
+  /// \param[in] _x X positions.
+  /// \param[in] _y Y positions.
+  /// \param[in] _n Number of positions.
+  /// \param[in] _cell Side of a cell, the largest neighbor distance.
+  void Build(const double *_x, const double *_y, size_t _n, double _cell);
+
+  /// \brief Call a function for every position in the cells around a
+  /// position, which includes all positions within one cell side.
+  /// \param[in] _x X position.
+  /// \param[in] _y Y position.
+  /// \param[in] _f Function called with the index of each position.
+  template <typename F>
+  void ForEachNear(double _x, double _y, F _f) const;
+
+ private:
+  /// \brief Bucket of a cell.
+  size_t Bucket(int64_t _cx, int64_t _cy) const;
+
+  /// \brief Cell coordinate of a position.
+  int64_t Cell(double _v) const;
+
+  /// \brief Side of a cell.
+  double cell_ = 1;
+
+  /// \brief Number of buckets minus one, a power of two minus one.
+  size_t mask_ = 0;
+
+  /// \brief Offset of the positions of each bucket, one past the end last.
+  std::vector<uint32_t> start_;
+
+  /// \brief Positions sorted by bucket.
+  std::vector<uint32_t> items_;
+
+  /// \brief Bucket of each position, kept between builds.
+  std::vector<uint32_t> keys_;
+};
+
+/// \brief Velocity level social force avoidance between actors and
+/// against static obstacles.
+///
+/// Each actor is pushed away from its neighbors and from the nearest
+/// obstacle, with a strength decaying exponentially with the distance and
+/// a small push to the right that breaks head-on deadlocks. The result is
+/// never faster than the desired velocity, so standing actors stay put.
+class CrowdAvoidance {
+ public:
+  /// \brief Get the avoidance shared by the actor plugins of the process,
+  /// creating it if needed. The shared avoidance is only used from the
+  /// physics thread.
+  /// \param[in] _params Avoidance parameters, only used by the call that
+  /// creates it.
+  /// \return Shared pointer to the avoidance.
+  static std::shared_ptr<CrowdAvoidance> Acquire(
+      const AvoidanceParams &_params);
+
+  /// \brief Set the avoidance parameters.
+  /// \param[in] _params Parameters.
+  void Configure(const AvoidanceParams &_params) { this->params_ = _params; }
+
+  /// \brief Avoidance parameters.
+  const AvoidanceParams &Params() const { return this->params_; }
+
+  /// \brief Static obstacles, built once.
+  ObstacleMap &Obstacles() { return this->obstacles_; }
+
+  /// \brief Whether the static obstacles have been built.
+  bool HasObstacles() const { return this->obstacles_built_; }
+
+  /// \brief Build the static obstacles.
+  /// \param[in] _boxes Footprints of the obstacles.
+  void BuildObstacles(const std::vector<ObstacleFootprint> &_boxes);
+
+  /// \brief Correct the velocity of every actor of a state store, and move
+  /// them accordingly.
+  /// \param[in,out] _store State advanced by UpdateActorStates().
+  /// \param[in] _dt Time delta of the update.
+  /// \param[in] _pool Threads sharing the corrections, null to compute
+  /// them on the calling thread.
+  void Apply(ActorStateStore &_store, double _dt,
+             ActorWorkerPool *_pool = nullptr);
+
+  /// \brief Register an actor updated on its own.
+  /// \param[in] _x X position of the actor, seen by the others until it
+  /// first calls Avoid().
+  /// \param[in] _y Y position of the actor.
+  /// \return Slot of the actor.
+  size_t Register(double _x, double _y);
+
+  /// \brief Unregister an actor.
+  /// \param[in] _slot Slot returned by Register().
+  void Unregister(size_t _slot);
+
+  /// \brief Correct the velocity of an actor updated on its own. The
+  /// positions of the other actors are the ones they had at the start of
+  /// the update.
+  /// \param[in] _slot Slot of the actor.
+  /// \param[in] _time Simulation time of the update.
+  /// \param[in] _x X position of the actor.
+  /// \param[in] _y Y position of the actor.
+  /// \param[in,out] _vx Desired X velocity, corrected.
+  /// \param[in,out] _vy Desired Y velocity, corrected.
+  void Avoid(size_t _slot, double _time, double _x, double _y, double &_vx,
+             double &_vy);
+
+ private:
+  /// \brief Correct the velocity of one actor.
+  /// \param[in] _self Index of the actor in the hash, skipped.
+  /// \param[in] _x X positions of the hashed actors.
+  /// \param[in] _y Y positions of the hashed actors.
+  /// \param[in] _px X position of the actor.
+  /// \param[in] _py Y position of the actor.
+  /// \param[in,out] _vx Desired X velocity, corrected.
+  /// \param[in,out] _vy Desired Y velocity, corrected.
+  void Correct(size_t _self, const double *_x, const double *_y, double _px,
+               double _py, double &_vx, double &_vy) const;
+
+  /// \brief Avoidance parameters.
+  AvoidanceParams params_;
+
+  /// \brief Static obstacles.
+  ObstacleMap obstacles_;
+
+  /// \brief Whether the static obstacles have been built.
+  bool obstacles_built_ = false;
+
+  /// \brief Positions of the actors in the current update.
+  SpatialHash hash_;
+
+  /// \brief Positions of the registered actors, far away for free slots.
+  std::vector<double> slot_x_;
+  std::vector<double> slot_y_;
+
+  /// \brief Snapshot of the registered positions the hash is built from.
+  std::vector<double> hashed_x_;
+  std::vector<double> hashed_y_;
+
+  /// \brief Simulation time of the last hash built for registered actors.
+  double hash_time_ = -1;
+
+  /// \brief Corrected velocities of the actors of a state store.
+  std::vector<double> corrected_x_;
+  std::vector<double> corrected_y_;
+};
+
+/////////////////////////////////////////////////
+template <typename F>
+void SpatialHash::ForEachNear(double _x, double _y, F _f) const {
+  if (this->items_.empty()) return;
+  const int64_t cx = this->Cell(_x);
+  const int64_t cy = this->Cell(_y);
+
+  // Neighboring cells can share a bucket, visit each bucket once
+  size_t visited[9];
+  size_t n = 0;
+  for (int64_t y = cy - 1; y <= cy + 1; ++y) {
+    for (int64_t x = cx - 1; x <= cx + 1; ++x) {
+      const size_t bucket = this->Bucket(x, y);
+      bool seen = false;
+      for (size_t k = 0; k < n; ++k) seen |= visited[k] == bucket;
+      if (seen) continue;
+      visited[n++] = bucket;
+      for (uint32_t k = this->start_[bucket]; k < this->start_[bucket + 1];
+           ++k) {
+        _f(this->items_[k]);
+      }
+    }
+  }
+}
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_CROWD_AVOIDANCE
@@ -1,21 +1,43 @@
 #ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_GAZEBO_ROS_ACTOR_COMMAND
 #define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_GAZEBO_ROS_ACTOR_COMMAND
 
+#include <gazebo_ros_actor_plugin/ResetActors.h>
+#include <gazebo_ros_actor_plugin/SetMode.h>
 #include <geometry_msgs/Twist.h>
+#include <geometry_msgs/TwistStamped.h>
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
 #include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <std_msgs/Bool.h>
+#include <std_msgs/String.h>
 #include <tf2/utils.h>
 
-#include <queue>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "gazebo/common/Plugin.hh"
 #include "gazebo/physics/physics.hh"
 #include "gazebo/util/system.hh"
+#include "gazebo_ros_actor_plugin/actor_command_arbiter.h"
+#include "gazebo_ros_actor_plugin/actor_command_router.h"
+#include "gazebo_ros_actor_plugin/actor_diagnostics.h"
+#include "gazebo_ros_actor_plugin/actor_orientation.h"
+#include "gazebo_ros_actor_plugin/actor_path.h"
+#include "gazebo_ros_actor_plugin/actor_ros_registrar.h"
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+#include "gazebo_ros_actor_plugin/actor_tf_broadcaster.h"
+#include "gazebo_ros_actor_plugin/actor_trajectories.h"
+#include "gazebo_ros_actor_plugin/animation_lod.h"
+#include "gazebo_ros_actor_plugin/crowd_avoidance.h"
+#include "gazebo_ros_actor_plugin/reusable_message.h"
+#include "gazebo_ros_actor_plugin/shared_callback_queue.h"
+#include "gazebo_ros_actor_plugin/trajectory_prediction.h"
+#include "gazebo_ros_actor_plugin/trajectory_recording.h"
+#include "gazebo_ros_actor_plugin/velocity_command_buffer.h"
 
 namespace gazebo {
 
@@ -43,18 +65,147 @@ class GazeboRosActorCommand : public ModelPlugin {
   /// \param[in] _model Pointer to the incoming velocity message.
   void VelCallback(const geometry_msgs::Twist::ConstPtr &msg);
 
+  /// \brief Callback function for receiving stamped velocity commands, used
+  /// in lockstep mode.
+  /// \param[in] msg Pointer to the incoming velocity message.
+  void VelStampedCallback(const geometry_msgs::TwistStamped::ConstPtr &msg);
+
+  /// \brief Hand a velocity command over to the update thread.
+  /// \param[in] _twist Commanded velocity.
+  /// \param[in] _stamp Simulation time from which the command applies, in
+  /// seconds, zero for the next update.
+  void PushVelocity(const geometry_msgs::Twist &_twist, double _stamp);
+
   /// \brief Callback function for receiving path commands from a publisher.
   /// \param[in] _model Pointer to the incoming path message.
   void PathCallback(const nav_msgs::Path::ConstPtr &msg);
 
+  /// \brief Callback function for the commands to this actor of a batched
+  /// message.
+  /// \param[in] _msg Pointer to the incoming commands.
+  /// \param[in] _command Index of the command to this actor.
+  void BatchedCommandCallback(
+      const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+      size_t _command);
+
+  /// \brief Callback function for receiving incremental path updates.
+  /// \param[in] msg Pointer to the incoming path update message.
+  void PathUpdateCallback(
+      const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &msg);
+
   /// \brief Callback function for receiving abort commands from a publisher.
   /// \param[in] _model Pointer to the incoming path message.
   void AbortCallback(const std_msgs::Bool::ConstPtr &msg);
 
+  /// \brief Callback function for receiving mode switches from a publisher.
+  /// \param[in] msg Pointer to the incoming mode name.
+  void ModeCallback(const std_msgs::String::ConstPtr &msg);
+
+  /// \brief Service switching the mode of the actor.
+  /// \param[in] _req Name of the requested mode.
+  /// \param[out] _res Whether the mode is known.
+  /// \return True, failures are reported in the response.
+  bool SetModeCallback(gazebo_ros_actor_plugin::SetMode::Request &_req,
+                       gazebo_ros_actor_plugin::SetMode::Response &_res);
+
   /// \brief Function that is called every update cycle.
   /// \param[in] _info Timing information.
   void OnUpdate(const common::UpdateInfo &_info);
 
+  /// \brief Run the controller of the mode for one control tick.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \param[in] _dt Time step the controller advances the actor by.
+  /// \param[in] _pose Pose of the actor in the world.
+  void Control(double _now, double _dt, ignition::math::Pose3d _pose);
+
+  /// \brief Predict the trajectory of the actor from the end of the
+  /// current control step, and publish it if it was predicted again.
+  /// \param[in] _now Current simulation time, in seconds.
+  void UpdatePrediction(double _now);
+
+  /// \brief Keep the actor at a pose until the next control tick.
+  /// \param[in] _pose Pose of the actor.
+  void HoldPose(const ignition::math::Pose3d &_pose);
+
+  /// \brief Controller of the path mode.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \param[in] _dt Time step of the control tick.
+  /// \param[in,out] _pose Pose of the actor, advanced by the controller.
+  /// \param[out] _twist Twist of the actor.
+  void UpdatePath(double _now, double _dt, ignition::math::Pose3d &_pose,
+                  geometry_msgs::Twist &_twist);
+
+  /// \brief Controller of the velocity mode, and of the modes preempted
+  /// by velocity commands: move the actor at the commanded velocities.
+  /// \param[in] _dt Time step of the control tick.
+  /// \param[in,out] _pose Pose of the actor, advanced by the controller.
+  /// \param[out] _twist Twist of the actor.
+  void UpdateVelocity(double _dt, ignition::math::Pose3d &_pose,
+                      geometry_msgs::Twist &_twist);
+
+  /// \brief Move the actor by the motion computed by a controller, taking
+  /// its yaw as the new yaw of the actor.
+  /// \param[in] _step Motion of the actor.
+  /// \param[out] _pose Pose of the actor.
+  /// \param[out] _twist Twist of the actor.
+  void ApplyStep(const ActorStep &_step, ignition::math::Pose3d &_pose,
+                 geometry_msgs::Twist &_twist);
+
+  /// \brief Controller of the scripted mode, which only measures the
+  /// motion of the script.
+  /// \param[in] _dt Time step of the control tick.
+  /// \param[in] _pose Pose of the actor.
+  /// \param[out] _twist Twist of the actor.
+  void UpdateScripted(double _dt, const ignition::math::Pose3d &_pose,
+                      geometry_msgs::Twist &_twist);
+
+  /// \brief Controller of the replay mode, which moves the actor to its
+  /// recorded pose at the end of the control step.
+  /// \param[in,out] _pose Pose of the actor, moved by the controller.
+  /// \param[out] _twist Twist of the actor.
+  void UpdateReplay(ignition::math::Pose3d &_pose,
+                    geometry_msgs::Twist &_twist);
+
+  /// \brief Record the pose of the actor at this update, if recording.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \param[in] _state Pose of the actor.
+  void Record(double _now, const ActorStep &_state);
+
+  /// \brief Service resetting the actor, optionally to a new start pose.
+  /// \param[in] _req Actor name and start pose, both optional.
+  /// \param[out] _res Whether the request was accepted.
+  /// \return True, failures are reported in the response.
+  bool ResetCallback(gazebo_ros_actor_plugin::ResetActors::Request &_req,
+                     gazebo_ros_actor_plugin::ResetActors::Response &_res);
+
+  /// \brief Apply the reset requested by the service, called by the update
+  /// thread.
+  void ApplyReset();
+
+  /// \brief Clear the command and path state and make the actor stand at
+  /// its current pose, in its initial mode.
+  void ResetState();
+
+  /// \brief Switch to another mode, called by the update thread.
+  /// \param[in] _mode New mode.
+  void SwitchMode(ActorMode _mode);
+
+  /// \brief Decide whether the skeleton of the actor is refreshed at this
+  /// update, from its distance to the level of detail reference.
+  /// \param[in] _now Current simulation time.
+  /// \param[in] _position Position of the actor at this update.
+  /// \return Whether the skeleton is animated.
+  bool UpdateAnimationLod(double _now,
+                          const ignition::math::Vector3d &_position);
+
+  /// \brief Set the skeleton animation played by the actor.
+  /// \param[in] _animation Animation to play.
+  void SetAnimation(ActorAnimation _animation);
+
+  /// \brief Create the ROS node, subscribe to the commands and advertise
+  /// the services and the odometry, then let the update thread use them.
+  void RegisterRos();
+
   /// \brief Custom callback queue thread for velocity commands.
   void VelQueueThread();
 
@@ -70,7 +221,15 @@ class GazeboRosActorCommand : public ModelPlugin {
   /// \brief Subscribers for velocity and path commands.
   ros::Subscriber vel_sub_;
   ros::Subscriber path_sub_;
+  ros::Subscriber path_update_sub_;
   ros::Subscriber abort_sub_;
+  ros::Subscriber mode_sub_;
+
+  /// \brief Server switching modes
+  ros::ServiceServer mode_srv_;
+
+  /// \brief Server resetting the actor
+  ros::ServiceServer reset_srv_;
 
   /// \brief Publisher for human actors
   ros::Publisher actor_pub_;
@@ -86,10 +245,44 @@ class GazeboRosActorCommand : public ModelPlugin {
   boost::thread pathCallbackQueueThread_;
   boost::thread abortCallbackQueueThread_;
 
+  /// \brief Number of threads of the spinner shared by all actors.
+  /// Zero falls back to one polling thread per custom callback queue.
+  int callback_threads_;
+
+  /// \brief Callback queue shared by all actors, when enabled.
+  std::shared_ptr<SharedCallbackQueue> shared_queue_;
+
+  /// \brief Number of threads registering the ROS interfaces of all
+  /// actors. Zero registers them during Load.
+  int registration_threads_;
+
+  /// \brief Registrar of the ROS interfaces shared by all actors, while
+  /// the registration of this actor may be pending.
+  std::shared_ptr<ActorRosRegistrar> registrar_;
+
+  /// \brief Whether the ROS interfaces are registered, until then the
+  /// update thread publishes nothing.
+  std::atomic<bool> ros_ready_;
+
   /// \brief Topic names for velocity and path commands.
   std::string vel_topic_;
   std::string path_topic_;
+  std::string path_update_topic_;
   std::string abort_topic_;
+  std::string mode_topic_;
+
+  /// \brief Topic of the commands batched for many actors, empty to
+  /// disable it
+  std::string command_topic_;
+
+  /// \brief Router of the batched commands, shared with the other actors
+  std::shared_ptr<ActorCommandRouter> command_router_;
+
+  /// \brief Name of the mode switching service
+  std::string mode_service_;
+
+  /// \brief Name of the reset service
+  std::string reset_service_;
 
   /// \brief Pointer to the parent actor.
   physics::ActorPtr actor_;
@@ -110,15 +303,49 @@ class GazeboRosActorCommand : public ModelPlugin {
   /// \brief Time of the last update.
   common::Time last_update_;
 
-  /// \brief Custom trajectory info.
-  physics::TrajectoryInfoPtr trajectoryInfo_;
+  /// \brief Custom trajectories of the animations.
+  ActorTrajectories trajectories_;
 
   /// \brief Flag to determine if
   /// the plugin will follow a path or velocity subscriber
   std::string follow_mode_;
 
-  /// \brief Target walking velocity for the actor
-  ignition::math::Pose3d target_vel_;
+  /// \brief Mode, velocity commands and path of the actor, from the ROS
+  /// callbacks to the update thread
+  ActorCommandArbiter arbiter_;
+
+  /// \brief Animation currently played
+  ActorAnimation animation_;
+
+  /// \brief Whether a reset was requested since the last update
+  std::atomic<bool> reset_requested_;
+
+  /// \brief Whether the requested reset moves the actor
+  bool reset_teleport_;
+
+  /// \brief Start position and yaw of the requested reset
+  ignition::math::Vector3d reset_pose_;
+
+  /// \brief Guards the requested reset
+  std::mutex reset_mutex_;
+
+  /// \brief Position and yaw of the actor at the last update in scripted
+  /// mode
+  ignition::math::Vector3d scripted_pose_;
+
+  /// \brief Yaw of the actor, authoritative outside of scripted mode where
+  /// the plugin sets the pose of the actor every update
+  ActorOrientation orientation_;
+
+  /// \brief Schedule of the control ticks
+  ControlClock control_clock_;
+
+  /// \brief Pose of the actor at the start of the current control step
+  ActorStep control_from_ = {};
+
+  /// \brief Pose of the actor at the end of the current control step, and
+  /// its twist during the step
+  ActorStep control_to_ = {};
 
   /// \brief Speed at which actor moves along path during path-following
   double lin_velocity_;
@@ -127,17 +354,13 @@ class GazeboRosActorCommand : public ModelPlugin {
   /// during rotational alignment
   double ang_velocity_;
 
-  /// \brief Current target pose
-  ignition::math::Vector3d target_pose_;
-
-  /// \brief List of target poses
-  std::vector<ignition::math::Vector3d> target_poses_;
-
-  /// \brief Index of current target pose
-  int idx_;
+  /// \brief Where to start following a full path, by name: "start" or
+  /// "closest"
+  std::string path_resume_;
 
-  /// \brief abort flag
-  bool abort_;
+  /// \brief Distance along the path at which the actor aims, zero to walk
+  /// from pose to pose
+  double lookahead_;
 
   /// \brief Maximum allowed distance between actor and target pose
   /// during path-following
@@ -150,11 +373,149 @@ class GazeboRosActorCommand : public ModelPlugin {
   /// \brief Default rotation for an actor
   double default_rotation_;
 
-  /// \brief Helper function to choose a new target pose
-  void ChooseNewTarget();
+  /// \brief Motion parameters of the path and velocity controllers, shared
+  /// with the batched kernel of the crowd manager
+  ActorKernelParams kernel_params_;
+
+  /// \brief Whether odometry has to be published at this update.
+  /// \param[in] _now Current simulation time.
+  /// \param[in] _asleep Whether the actor is asleep.
+  bool OdomDue(const common::Time &_now, bool _asleep) const;
+
+  /// \brief Publish the odometry of the actor.
+  /// \param[in] _now Current simulation time.
+  /// \param[in] _state Pose and twist of the actor.
+  /// \param[in] _orientation Orientation of the actor at that pose.
+  void PublishOdom(const common::Time &_now, const ActorStep &_state,
+                   const ActorOrientation &_orientation);
+
+  /// \brief Add the frame of the actor to the TF broadcast of this
+  /// update, if it is due.
+  /// \param[in] _now Current simulation time.
+  /// \param[in] _state Pose of the actor.
+  /// \param[in] _orientation Orientation of the actor at that pose.
+  void BroadcastTf(const common::Time &_now, const ActorStep &_state,
+                   const ActorOrientation &_orientation);
+
+  /// \brief Last published odometry message, reused when possible
+  nav_msgs::Odometry::Ptr odom_msg_;
+
+  /// \brief Frame of the odometry, the predicted trajectory and the TF
+  /// of the actor
+  std::string odom_frame_;
+
+  /// \brief Frame of the actor, named after it
+  std::string base_frame_;
+
+  /// \brief Whether the frame of the actor is broadcast on /tf
+  bool publish_tf_;
+
+  /// \brief Rate of the TF broadcasts, zero to broadcast every update
+  double tf_rate_;
+
+  /// \brief TF broadcaster shared with the other actors, set by
+  /// RegisterRos, null when disabled
+  std::shared_ptr<ActorTfBroadcaster> tf_broadcaster_;
+
+  /// \brief Rate at which odometry is published, zero to publish it
+  /// every update
+  double odom_rate_;
+
+  /// \brief Only publish odometry when someone is subscribed to it
+  bool odom_lazy_;
+
+  /// \brief Rate at which the odometry of a sleeping actor is kept alive,
+  /// zero to publish none
+  double idle_odom_rate_;
+
+  /// \brief Whether the actor stood still at the last update, and sleeps
+  /// from the next one if it still does
+  bool asleep_ = false;
+
+  /// \brief Time of the last odometry publication
+  common::Time last_odom_;
+
+  /// \brief Parameters of the trajectory prediction
+  PredictionParams prediction_params_;
+
+  /// \brief Trajectory predicted for the actor
+  TrajectoryPredictor predictor_;
+
+  /// \brief Publisher of the predicted trajectory, latched
+  ros::Publisher prediction_pub_;
+
+  /// \brief Last published prediction, reused when possible
+  nav_msgs::Path::Ptr prediction_msg_;
+
+  /// \brief Recording replayed in replay mode, null without replay file
+  std::shared_ptr<const TrajectoryRecording> replay_;
+
+  /// \brief Trajectory of the actor in the replayed recording
+  RecordedTrack replay_track_;
+
+  /// \brief Index of the recorded pose sampled last
+  size_t replay_hint_ = 0;
+
+  /// \brief Recorder shared with the other actors, null when not
+  /// recording
+  std::shared_ptr<TrajectoryRecorder> recorder_;
+
+  /// \brief Track of the actor in the recorder
+  size_t record_track_ = 0;
+
+  /// \brief How pending velocity commands are consumed
+  std::string command_policy_;
+
+  /// \brief Maximum number of pending velocity commands
+  int command_queue_size_;
+
+  /// \brief Time without velocity command after which the actor stops
+  double command_timeout_;
+
+  /// \brief How velocity commands interact with the other modes, by name
+  std::string command_arbitration_;
+
+  /// \brief Time without velocity command after which a preempted mode
+  /// resumes
+  double preempt_timeout_;
+
+  /// \brief Apply commands and paths at the simulation time they are
+  /// stamped with, and stamp odometry with the simulation time
+  bool lockstep_;
+
+#ifdef ACTOR_DIAGNOSTICS
+  /// \brief Publish the hot path measurements when they are due.
+  /// \param[in] _now Current simulation time.
+  void PublishDiagnostics(const common::Time &_now);
+
+  /// \brief Hot path measurements of the actor
+  ActorDiagnostics diagnostics_;
+
+  /// \brief Publisher of the measurements
+  ros::Publisher diagnostics_pub_;
+
+  /// \brief Rate at which the measurements are published
+  double diagnostics_rate_;
+
+  /// \brief Time of the last publication of the measurements
+  common::Time last_diagnostics_;
+#endif
+
+  /// \brief Avoidance shared with the other actors, null when disabled
+  std::shared_ptr<CrowdAvoidance> avoidance_;
+
+  /// \brief Slot of the actor in the shared avoidance
+  size_t avoidance_slot_;
+
+  /// \brief Parameters of the animation level of detail
+  AnimationLodParams lod_params_;
+
+  /// \brief Reference shared with the other actors, null when the level of
+  /// detail is disabled
+  std::shared_ptr<AnimationLodReference> lod_reference_;
 
-  /// \brief Data structure for saving velocity command
-  std::queue<ignition::math::Vector3d> cmd_queue_;
+  /// \brief Level of detail of the skeleton animation
+  AnimationLod animation_lod_;
 };
 }  // namespace gazebo
 
@@ -0,0 +1,582 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_GAZEBO_ROS_CROWD_MANAGER
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_GAZEBO_ROS_CROWD_MANAGER
+
+#include <gazebo_ros_actor_plugin/CrowdState.h>
+#include <gazebo_ros_actor_plugin/ResetActors.h>
+#include <gazebo_ros_actor_plugin/SetMode.h>
+#include <geometry_msgs/Twist.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/Path.h>
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+#include <std_msgs/Bool.h>
+#include <std_msgs/String.h>
+#include <tf2/utils.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gazebo/common/Plugin.hh"
+#include "gazebo/physics/physics.hh"
+#include "gazebo/util/system.hh"
+#include "gazebo_ros_actor_plugin/actor_command_arbiter.h"
+#include "gazebo_ros_actor_plugin/actor_command_router.h"
+#include "gazebo_ros_actor_plugin/actor_diagnostics.h"
+#include "gazebo_ros_actor_plugin/actor_orientation.h"
+#include "gazebo_ros_actor_plugin/actor_path.h"
+#include "gazebo_ros_actor_plugin/actor_ros_registrar.h"
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+#include "gazebo_ros_actor_plugin/actor_tf_broadcaster.h"
+#include "gazebo_ros_actor_plugin/actor_trajectories.h"
+#include "gazebo_ros_actor_plugin/actor_worker_pool.h"
+#include "gazebo_ros_actor_plugin/animation_lod.h"
+#include "gazebo_ros_actor_plugin/crowd_avoidance.h"
+#include "gazebo_ros_actor_plugin/reusable_message.h"
+#include "gazebo_ros_actor_plugin/shared_callback_queue.h"
+#include "gazebo_ros_actor_plugin/trajectory_prediction.h"
+#include "gazebo_ros_actor_plugin/trajectory_recording.h"
+#include "gazebo_ros_actor_plugin/velocity_command_buffer.h"
+
+namespace gazebo {
+
+/// \brief Gazebo world plugin that commands every actor of the world
+/// from a single update callback and a single ROS callback spinner.
+///
+/// The kinematic state of all actors is kept in an ActorStateStore and
+/// advanced by one batched kernel call per update cycle. The computations
+/// of an update may be split between worker threads, while Gazebo is only
+/// called from the physics thread.
+
+class GazeboRosCrowdManager : public WorldPlugin {
+ public:
+  /// \brief Constructor
+  GazeboRosCrowdManager();
+
+  /// \brief Destructor
+  ~GazeboRosCrowdManager();
+
+  /// \brief Load the crowd manager plugin.
+  /// \param[in] _world Pointer to the world.
+  /// \param[in] _sdf Pointer to the plugin's SDF elements.
+  virtual void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+  // \brief Reset the plugin.
+  virtual void Reset();
+
+ private:
+  /// \brief ROS and command state of a single actor handled by the manager.
+  /// Its kinematic state lives in the state store at the same index.
+  struct ManagedActor {
+    /// \brief Pointer to the actor.
+    physics::ActorPtr actor;
+
+    /// \brief Name of the actor, used as namespace for its topics.
+    std::string name;
+
+    /// \brief Frame of the actor, named after it.
+    std::string base_frame;
+
+    /// \brief Subscribers for velocity, path and abort commands.
+    ros::Subscriber vel_sub;
+    ros::Subscriber path_sub;
+    ros::Subscriber path_update_sub;
+    ros::Subscriber abort_sub;
+    ros::Subscriber mode_sub;
+
+    /// \brief Server switching modes
+    ros::ServiceServer mode_srv;
+
+    /// \brief Odometry publisher.
+    ros::Publisher odom_pub;
+
+    /// \brief Last published odometry message, reused when possible
+    nav_msgs::Odometry::Ptr odom_msg;
+
+    /// \brief Custom trajectories of the animations.
+    ActorTrajectories trajectories;
+
+    /// \brief Mode, velocity commands and path of the actor, from the ROS
+    /// callbacks to the update thread. The state store holds the velocity
+    /// mode instead of its mode while velocity commands preempt it.
+    ActorCommandArbiter arbiter;
+
+    /// \brief Animation currently played
+    ActorAnimation animation = ANIMATION_STANDING;
+
+    /// \brief Velocity of the actor in scripted mode, measured from the
+    /// motion of its script
+    ignition::math::Vector3d scripted_vel;
+
+    /// \brief Level of detail of the skeleton animation
+    AnimationLod animation_lod;
+
+    /// \brief Whether the actor stood still at the last update, and sleeps
+    /// from the next one if it still does
+    bool asleep = false;
+
+    /// \brief Simulation time of the last odometry publication
+    double last_odom = 0;
+
+    /// \brief Trajectory predicted for the actor
+    TrajectoryPredictor predictor;
+
+    /// \brief Publisher of the predicted trajectory, latched
+    ros::Publisher prediction_pub;
+
+    /// \brief Last published prediction, reused when possible
+    nav_msgs::Path::Ptr prediction_msg;
+
+    /// \brief Pose of the actor at this update, computed by ComputeActor
+    /// and applied to Gazebo by CommitActor
+    ActorStep state;
+
+    /// \brief Orientation of the actor at this update
+    ActorOrientation orientation;
+
+    /// \brief Whether CommitActor moves the actor at this update
+    bool move = false;
+
+    /// \brief Trajectory of the actor in the replayed recording
+    RecordedTrack replay_track;
+
+    /// \brief Index of the recorded pose sampled last
+    size_t replay_hint = 0;
+
+    /// \brief Track of the actor in the recorder
+    size_t record_track = 0;
+
+#ifdef ACTOR_DIAGNOSTICS
+    /// \brief Hot path measurements of the actor
+    ActorDiagnostics diagnostics;
+
+    /// \brief Time spent on the actor at the current update, outside the
+    /// batched kernel
+    double work_time = 0;
+#endif
+  };
+
+  /// \brief Reset of one actor requested by the reset service.
+  struct ResetRequest {
+    /// \brief Index of the actor.
+    size_t idx;
+
+    /// \brief Whether the actor is moved to the start pose.
+    bool teleport;
+
+    /// \brief Start pose in the odometry frame.
+    double x;
+    double y;
+    double yaw;
+  };
+
+  /// \brief Callback function for receiving velocity commands.
+  /// \param[in] msg Pointer to the incoming velocity message.
+  /// \param[in] _idx Index of the commanded actor.
+  void VelCallback(const geometry_msgs::Twist::ConstPtr &msg, size_t _idx);
+
+  /// \brief Callback function for receiving stamped velocity commands, used
+  /// in lockstep mode.
+  /// \param[in] msg Pointer to the incoming velocity message.
+  /// \param[in] _idx Index of the commanded actor.
+  void VelStampedCallback(const geometry_msgs::TwistStamped::ConstPtr &msg,
+                          size_t _idx);
+
+  /// \brief Hand a velocity command over to the update thread.
+  /// \param[in] _twist Commanded velocity.
+  /// \param[in] _stamp Simulation time from which the command applies, in
+  /// seconds, zero for the next update.
+  /// \param[in] _idx Index of the commanded actor.
+  void PushVelocity(const geometry_msgs::Twist &_twist, double _stamp,
+                    size_t _idx);
+
+  /// \brief Callback function for receiving path commands.
+  /// \param[in] msg Pointer to the incoming path message.
+  /// \param[in] _idx Index of the commanded actor.
+  void PathCallback(const nav_msgs::Path::ConstPtr &msg, size_t _idx);
+
+  /// \brief Callback function for receiving the commands batched for
+  /// many actors.
+  /// \param[in] msg Pointer to the incoming commands.
+  void BatchedCommandCallback(
+      const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &msg);
+
+  /// \brief Callback function for receiving incremental path updates.
+  /// \param[in] msg Pointer to the incoming path update message.
+  /// \param[in] _idx Index of the commanded actor.
+  void PathUpdateCallback(
+      const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &msg, size_t _idx);
+
+  /// \brief Callback function for receiving abort commands.
+  /// \param[in] msg Pointer to the incoming abort message.
+  /// \param[in] _idx Index of the commanded actor.
+  void AbortCallback(const std_msgs::Bool::ConstPtr &msg, size_t _idx);
+
+  /// \brief Callback function for receiving mode switches.
+  /// \param[in] msg Pointer to the incoming mode name.
+  /// \param[in] _idx Index of the commanded actor.
+  void ModeCallback(const std_msgs::String::ConstPtr &msg, size_t _idx);
+
+  /// \brief Service switching the mode of an actor.
+  /// \param[in] _req Name of the requested mode.
+  /// \param[out] _res Whether the mode is known.
+  /// \param[in] _idx Index of the commanded actor.
+  /// \return True, failures are reported in the response.
+  bool SetModeCallback(gazebo_ros_actor_plugin::SetMode::Request &_req,
+                       gazebo_ros_actor_plugin::SetMode::Response &_res,
+                       size_t _idx);
+
+  /// \brief Service resetting a subset of the actors.
+  /// \param[in] _req Names and start poses of the actors.
+  /// \param[out] _res Whether the request was accepted.
+  /// \return True, failures are reported in the response.
+  bool ResetCallback(gazebo_ros_actor_plugin::ResetActors::Request &_req,
+                     gazebo_ros_actor_plugin::ResetActors::Response &_res);
+
+  /// \brief Apply the resets requested by the service, called by the
+  /// update thread.
+  void ApplyResets();
+
+  /// \brief Switch an actor to another mode, called by the update thread.
+  /// \param[in] _idx Index of the actor.
+  /// \param[in] _mode New mode.
+  void SwitchMode(size_t _idx, ActorMode _mode);
+
+  /// \brief Set the skeleton animation played by an actor.
+  /// \param[in] _idx Index of the actor.
+  /// \param[in] _animation Animation to play.
+  void SetAnimation(size_t _idx, ActorAnimation _animation);
+
+  /// \brief Function that is called every update cycle.
+  /// \param[in] _info Timing information.
+  void OnUpdate(const common::UpdateInfo &_info);
+
+  /// \brief Time stamp of the messages published at an update.
+  /// \param[in] _sim_time Simulation time of the update.
+  ros::Time Stamp(const common::Time &_sim_time) const;
+
+  /// \brief Run a function on the index of every actor, split between
+  /// the worker threads when there are any.
+  /// \param[in] _grain Number of actors a thread takes at once.
+  /// \param[in] _f Function called with the index of each actor, for
+  /// distinct actors concurrently.
+  template <typename F>
+  void ForEachActor(size_t _grain, F _f) {
+    auto chunk = [&](size_t _begin, size_t _end) {
+      for (size_t i = _begin; i < _end; ++i) _f(i);
+    };
+    if (this->workers_) {
+      this->workers_->ParallelFor(this->actors_.size(), _grain, chunk);
+    } else {
+      chunk(0, this->actors_.size());
+    }
+  }
+
+  /// \brief Bring an actor in line with Gazebo at a control tick: finish
+  /// its animation over the previous control step, switch it to a
+  /// requested mode and read back the pose of a scripted actor. Called
+  /// from the physics thread only.
+  /// \param[in] _idx Index of the actor.
+  void SyncActor(size_t _idx);
+
+  /// \brief Feed the pending command or path target of an actor
+  /// into the state store, at a control tick.
+  /// \param[in] _idx Index of the actor.
+  void PrepareActor(size_t _idx);
+
+  /// \brief Compute the pose of an actor part of the way through its
+  /// control step, from the state computed by the kernel, and publish its
+  /// odometry.
+  /// \param[in] _idx Index of the actor.
+  /// \param[in] _stamp Time stamp of the odometry message.
+  /// \param[in] _publish_odom Whether odometry is due at this update.
+  /// \param[in] _publish_tf Whether the TF is broadcast at this update.
+  void ComputeActor(size_t _idx, const ros::Time &_stamp, bool _publish_odom,
+                    bool _publish_tf);
+
+  /// \brief Apply the pose computed by ComputeActor to an actor and add
+  /// its frame to the TF. Called from the physics thread only.
+  /// \param[in] _idx Index of the actor.
+  /// \param[in] _stamp Time stamp of the TF.
+  /// \param[in] _publish_tf Whether the TF is broadcast at this update.
+  void CommitActor(size_t _idx, const ros::Time &_stamp, bool _publish_tf);
+
+  /// \brief Move a replayed actor to its recorded pose at the end of the
+  /// current control step, over the step left by the kernel.
+  /// \param[in] _idx Index of the actor.
+  void ReplayActor(size_t _idx);
+
+  /// \brief Predict the trajectory of an actor from the end of the
+  /// current control step, and publish it if it was predicted again.
+  /// \param[in] _idx Index of the actor.
+  /// \param[in] _stamp Time stamp of the end of the control step.
+  void UpdatePrediction(size_t _idx, const ros::Time &_stamp);
+
+  /// \brief Publish the state of every actor in one message.
+  /// \param[in] _stamp Time stamp of the message.
+  void PublishCrowdState(const ros::Time &_stamp);
+
+  /// \brief Reset a single actor to stand at its current pose.
+  /// \param[in] _idx Index of the actor.
+  void ResetActor(size_t _idx);
+
+  /// \brief Subscribe to the commands of an actor and advertise its
+  /// services and odometry.
+  /// \param[in] _idx Index of the actor.
+  void RegisterActorRos(size_t _idx);
+
+  /// \brief Subscribe to the commands and advertise the services and
+  /// topics shared by the actors.
+  void RegisterRos();
+
+  /// \brief ROS node handle.
+  ros::NodeHandle *ros_node_;
+
+  /// \brief Callback queue shared by all actors.
+  std::shared_ptr<SharedCallbackQueue> shared_queue_;
+
+  /// \brief Number of threads of the shared callback spinner.
+  int callback_threads_;
+
+  /// \brief Number of threads registering the ROS interfaces, zero to
+  /// register them during Load.
+  int registration_threads_;
+
+  /// \brief Registrar of the ROS interfaces, shared with the actor
+  /// plugins of the process.
+  std::shared_ptr<ActorRosRegistrar> registrar_;
+
+  /// \brief Number of registrations not done yet. The update thread
+  /// publishes nothing until they are all done.
+  std::atomic<size_t> ros_pending_;
+
+  /// \brief Whether the ROS interfaces are registered, read once per
+  /// update from ros_pending_.
+  bool ros_ready_;
+
+  /// \brief Topic names for velocity, path and abort commands,
+  /// relative to each actor's namespace.
+  std::string vel_topic_;
+  std::string path_topic_;
+  std::string path_update_topic_;
+  std::string abort_topic_;
+  std::string mode_topic_;
+
+  /// \brief Topic of the commands batched for many actors, empty to
+  /// disable it
+  std::string command_topic_;
+
+  /// \brief Subscriber to the batched commands
+  ros::Subscriber command_sub_;
+
+  /// \brief Name of the mode switching service, relative to each actor's
+  /// namespace
+  std::string mode_service_;
+
+  /// \brief Name of the reset service
+  std::string reset_service_;
+
+  /// \brief Server resetting actors
+  ros::ServiceServer reset_srv_;
+
+  /// \brief Resets requested since the last update, under reset_mutex_
+  std::vector<ResetRequest> pending_resets_;
+
+  /// \brief Whether pending_resets_ has any reset
+  std::atomic<bool> reset_requested_;
+
+  /// \brief Guards pending_resets_
+  std::mutex reset_mutex_;
+
+  /// \brief Index of each actor by name
+  std::unordered_map<std::string, size_t> actor_index_;
+
+  /// \brief Where to start following a full path, by name: "start" or
+  /// "closest"
+  std::string path_resume_;
+
+  /// \brief Pointer to the world
+  physics::WorldPtr world_;
+
+  /// \brief Pointer to the sdf element.
+  sdf::ElementPtr sdf_;
+
+  /// \brief Actors handled by the manager. A deque keeps them in place
+  /// as it grows, since their command handoff state cannot be moved.
+  std::deque<ManagedActor> actors_;
+
+  /// \brief Kinematic state of the actors, indexed like actors_.
+  ActorStateStore store_;
+
+  /// \brief Parameters of the update kernel.
+  ActorKernelParams kernel_params_;
+
+  /// \brief Orientation with the default rotation folded in, copied and
+  /// set to the yaw of an actor each time it is committed.
+  ActorOrientation orientation_;
+
+  /// \brief Multiplier to base animation speed to adjust
+  /// the speed of actor's animation and foot swinging.
+  double animation_factor_;
+
+  /// \brief List of connections
+  std::vector<event::ConnectionPtr> connections_;
+
+  /// \brief Time of the last update.
+  common::Time last_update_;
+
+  /// \brief Flag to determine if
+  /// the actors will follow a path or velocity subscriber
+  std::string follow_mode_;
+
+  /// \brief Time step of the current control tick, in seconds.
+  double dt_;
+
+  /// \brief Schedule of the control ticks, shared by every actor.
+  ControlClock control_clock_;
+
+  /// \brief Fraction of the control step of the kernel reached at the
+  /// current update.
+  double alpha_;
+
+  /// \brief Fraction of the control step reached at the previous update.
+  double last_alpha_;
+
+  /// \brief Maximum allowed distance between actor and target pose
+  /// during path-following
+  double lin_tolerance_;
+
+  /// \brief Distance along the path at which actors aim, zero to walk
+  /// from pose to pose
+  double lookahead_;
+
+  /// \brief How pending velocity commands are consumed
+  std::string command_policy_;
+
+  /// \brief Maximum number of pending velocity commands
+  int command_queue_size_;
+
+  /// \brief Time without velocity command after which an actor stops
+  double command_timeout_;
+
+  /// \brief How velocity commands interact with the other modes, by name
+  std::string command_arbitration_;
+
+  /// \brief Time without velocity command after which a preempted mode
+  /// resumes
+  double preempt_timeout_;
+
+  /// \brief Simulation time of the current update, in seconds.
+  double sim_time_;
+
+  /// \brief Apply commands and paths at the simulation time they are
+  /// stamped with, and stamp odometry with the simulation time
+  bool lockstep_;
+
+  /// \brief Rate at which odometry is published, zero to publish it
+  /// every update
+  double odom_rate_;
+
+  /// \brief Only publish odometry of actors someone is subscribed to
+  bool odom_lazy_;
+
+  /// \brief Rate at which the odometry of a sleeping actor is kept alive,
+  /// zero to publish none
+  double idle_odom_rate_;
+
+  /// \brief Time of the last odometry publication
+  common::Time last_odom_;
+
+  /// \brief Frame of the odometry, the predicted trajectories, the TF and
+  /// the aggregated state of the actors
+  std::string odom_frame_;
+
+  /// \brief Frame of each actor, below its name
+  std::string base_frame_;
+
+  /// \brief Whether the actor frames are broadcast on /tf
+  bool publish_tf_;
+
+  /// \brief Rate of the TF broadcasts, zero to broadcast every update
+  double tf_rate_;
+
+  /// \brief TF broadcaster of the actor frames, set by RegisterRos, null
+  /// when disabled
+  std::shared_ptr<ActorTfBroadcaster> tf_broadcaster_;
+
+  /// \brief Publisher of the aggregated state of all actors
+  ros::Publisher crowd_pub_;
+
+  /// \brief Topic of the aggregated state of all actors
+  std::string crowd_state_topic_;
+
+  /// \brief Rate at which the aggregated state is published, zero to
+  /// publish it every update
+  double crowd_state_rate_;
+
+  /// \brief Time of the last aggregated state publication
+  common::Time last_crowd_state_;
+
+  /// \brief Last published aggregated state, reused when possible
+  gazebo_ros_actor_plugin::CrowdState::Ptr crowd_msg_;
+
+  /// \brief Parameters of the trajectory prediction
+  PredictionParams prediction_params_;
+
+  /// \brief Recording replayed in replay mode, null without replay file
+  std::shared_ptr<const TrajectoryRecording> replay_;
+
+  /// \brief Recorder of the poses of the actors, null when not recording
+  std::shared_ptr<TrajectoryRecorder> recorder_;
+
+  /// \brief Threads sharing the computations of an update with the
+  /// physics thread, null to run them on the physics thread alone
+  std::unique_ptr<ActorWorkerPool> workers_;
+
+#ifdef ACTOR_DIAGNOSTICS
+  /// \brief Publish the hot path measurements when they are due.
+  /// \param[in] _now Current simulation time.
+  void PublishDiagnostics(const common::Time &_now);
+
+  /// \brief Duration of the whole update
+  LatencyHistogram update_time_;
+
+  /// \brief Duration of the batched kernel and avoidance
+  LatencyHistogram kernel_time_;
+
+  /// \brief Publisher of the measurements
+  ros::Publisher diagnostics_pub_;
+
+  /// \brief Rate at which the measurements are published
+  double diagnostics_rate_;
+
+  /// \brief Time of the last publication of the measurements
+  common::Time last_diagnostics_;
+#endif
+
+  /// \brief Whether actors avoid each other and static obstacles
+  bool avoidance_enabled_;
+
+  /// \brief Avoidance between the managed actors
+  CrowdAvoidance avoidance_;
+
+  /// \brief Parameters of the animation level of detail
+  AnimationLodParams lod_params_;
+
+  /// \brief Reference of the level of detail, null when it is disabled
+  std::shared_ptr<AnimationLodReference> lod_reference_;
+
+  /// \brief Whether the position of the reference is known at this update
+  bool lod_valid_ = false;
+
+  /// \brief Position of the reference at this update
+  ignition::math::Vector3d lod_position_;
+};
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_GAZEBO_ROS_CROWD_MANAGER
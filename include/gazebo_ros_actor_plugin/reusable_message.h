@@ -0,0 +1,30 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_REUSABLE_MESSAGE
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_REUSABLE_MESSAGE
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace gazebo {
+
+/// \brief Get a message that can be filled and published by shared pointer.
+///
+/// Publishing by shared pointer lets subscribers in the same process
+/// receive the message without serialization, but then it must not be
+/// modified while they hold it. The last published message is reused when
+/// nobody else references it anymore, and copied otherwise, so there is
+/// no allocation in the steady state.
+/// \param[in,out] _msg Last published message, replaced if still in use.
+/// \return Message safe to modify.
+template <typename M>
+M &ReusableMessage(boost::shared_ptr<M> &_msg) {
+  if (!_msg) {
+    _msg = boost::make_shared<M>();
+  } else if (!_msg.unique()) {
+    _msg = boost::make_shared<M>(*_msg);
+  }
+  return *_msg;
+}
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_REUSABLE_MESSAGE
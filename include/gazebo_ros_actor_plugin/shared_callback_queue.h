@@ -0,0 +1,45 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_SHARED_CALLBACK_QUEUE
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_SHARED_CALLBACK_QUEUE
+
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
+
+#include <memory>
+
+namespace gazebo {
+
+/// \brief Callback queue shared by every actor of the process, served by
+/// a single ros::AsyncSpinner.
+///
+/// Spinner threads sleep on the queue until a message arrives, so idle
+/// actors cost no CPU and callbacks run as soon as a message is received.
+/// The queue lives as long as at least one actor holds a reference to it.
+class SharedCallbackQueue {
+ public:
+  /// \brief Get the shared queue, creating and starting it if needed.
+  /// \param[in] _threads Number of spinner threads, only used by the
+  /// call that creates the queue.
+  /// \return Shared pointer to the queue.
+  static std::shared_ptr<SharedCallbackQueue> Acquire(unsigned int _threads);
+
+  /// \brief Destructor, stops the spinner.
+  ~SharedCallbackQueue();
+
+  /// \brief Queue to pass to ros::SubscribeOptions.
+  ros::CallbackQueue *Queue() { return &this->queue_; }
+
+ private:
+  /// \brief Constructor
+  /// \param[in] _threads Number of spinner threads.
+  explicit SharedCallbackQueue(unsigned int _threads);
+
+  /// \brief Queue holding the callbacks of every subscriber.
+  ros::CallbackQueue queue_;
+
+  /// \brief Spinner serving the queue.
+  std::unique_ptr<ros::AsyncSpinner> spinner_;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_SHARED_CALLBACK_QUEUE
@@ -0,0 +1,86 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_SPSC_RING
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_SPSC_RING
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace gazebo {
+
+/// \brief Bounded lock-free single-producer/single-consumer ring buffer.
+///
+/// Used to hand commands from a ROS callback thread over to the Gazebo
+/// update thread without either of them ever blocking. Push must only be
+/// called by one thread at a time, and so must Pop.
+/// \tparam T Element type.
+/// \tparam N Capacity, must be a power of two.
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of 2");
+
+ public:
+  /// \brief Add an element, called by the producer.
+  /// \param[in] _value Element to add.
+  /// \return False if the ring is full and the element was dropped.
+  bool Push(const T &_value) {
+    const size_t head = this->head_.load(std::memory_order_relaxed);
+    if (head - this->tail_.load(std::memory_order_acquire) == N) return false;
+    this->buffer_[head & (N - 1)] = _value;
+    this->head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Remove the oldest element, called by the consumer.
+  /// \param[out] _value Removed element.
+  /// \return False if the ring was empty.
+  bool Pop(T &_value) {
+    const size_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail == this->head_.load(std::memory_order_acquire)) return false;
+    _value = this->buffer_[tail & (N - 1)];
+    this->tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Read the oldest element without removing it,
+  /// called by the consumer.
+  /// \param[out] _value Oldest element.
+  /// \return False if the ring was empty.
+  bool Peek(T &_value) const {
+    const size_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail == this->head_.load(std::memory_order_acquire)) return false;
+    _value = this->buffer_[tail & (N - 1)];
+    return true;
+  }
+
+  /// \brief Drop every element, called by the consumer.
+  void Clear() {
+    this->tail_.store(this->head_.load(std::memory_order_acquire),
+                      std::memory_order_release);
+  }
+
+  /// \brief Number of elements currently stored.
+  size_t Size() const {
+    return this->head_.load(std::memory_order_acquire) -
+           this->tail_.load(std::memory_order_acquire);
+  }
+
+  /// \brief Whether the ring holds no element.
+  bool Empty() const { return this->Size() == 0; }
+
+  /// \brief Maximum number of elements the ring can hold.
+  static constexpr size_t Capacity() { return N; }
+
+ private:
+  /// \brief Storage of the elements.
+  std::array<T, N> buffer_;
+
+  /// \brief Number of elements pushed so far, written by the producer.
+  alignas(64) std::atomic<size_t> head_{0};
+
+  /// \brief Number of elements popped so far, written by the consumer.
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_SPSC_RING
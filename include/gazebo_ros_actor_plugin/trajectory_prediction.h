@@ -0,0 +1,151 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_TRAJECTORY_PREDICTION
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_TRAJECTORY_PREDICTION
+
+#include <nav_msgs/Path.h>
+#include <ros/time.h>
+
+#include <sdf/Element.hh>
+
+#include <cstddef>
+#include <vector>
+
+#include "gazebo_ros_actor_plugin/actor_orientation.h"
+#include "gazebo_ros_actor_plugin/actor_path.h"
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+#include "gazebo_ros_actor_plugin/trajectory_recording.h"
+
+namespace gazebo {
+
+/// \brief Parameters of the trajectory prediction.
+struct PredictionParams {
+  /// \brief Time predicted ahead of the actor, 0 disables the prediction.
+  double horizon = 0;
+
+  /// \brief Time between two predicted poses.
+  double step = 0.1;
+
+  /// \brief Distance, and difference in yaw in radians, by which the actor
+  /// may drift from its prediction before it is predicted again.
+  double tolerance = 0.1;
+};
+
+/// \brief Read the trajectory prediction parameters of a plugin.
+/// \param[in] _sdf Pointer to the plugin's SDF elements.
+/// \param[in,out] _params Parameters, left unchanged when not set.
+void LoadPredictionParams(const sdf::ElementPtr &_sdf,
+                          PredictionParams &_params);
+
+/// \brief What an actor is doing, which its future motion follows from.
+struct ActorPlan {
+  /// \brief Motion model: idle, velocity, path or replay.
+  ActorMode mode = ACTOR_MODE_IDLE;
+
+  /// \brief Commanded linear and angular velocity in velocity mode.
+  double v = 0;
+  double w = 0;
+
+  /// \brief Path followed in path mode, standing still when null or
+  /// empty.
+  ActorPathPtr path;
+
+  /// \brief Index of the current target on the path.
+  size_t idx = 0;
+
+  /// \brief Arc length of the path reached, when looking ahead.
+  double progress = 0;
+
+  /// \brief Lookahead distance along the path, zero to walk from pose to
+  /// pose.
+  double lookahead = 0;
+
+  /// \brief Distance at which a target of the path is reached.
+  double lin_tolerance = 0;
+
+  /// \brief Recorded trajectory replayed in replay mode, standing still
+  /// when null or empty.
+  const RecordedTrack *track = nullptr;
+
+  /// \brief Simulation time the prediction starts at, in replay mode.
+  double time = 0;
+};
+
+/// \brief Predict the motion of an actor following its plan, with the
+/// controllers of the path and velocity modes, or from its recording in
+/// replay mode.
+/// \param[in] _plan Plan of the actor, copied so the prediction does not
+/// advance it.
+/// \param[in] _params Motion parameters.
+/// \param[in] _start Pose of the actor the prediction starts from.
+/// \param[in] _step Time between two predicted poses.
+/// \param[in] _count Number of predicted poses, the start included.
+/// \param[out] _poses Predicted poses, with the twist reaching each one.
+void PredictTrajectory(ActorPlan _plan, const ActorKernelParams &_params,
+                       const ActorStep &_start, double _step, size_t _count,
+                       std::vector<ActorStep> &_poses);
+
+/// \brief Trajectory predicted for an actor over a horizon, kept until
+/// its plan changes.
+///
+/// The prediction is only computed again when the plan of the actor
+/// changes, when the actor drifts from it, for instance while avoiding
+/// another one, or once half of the horizon has elapsed. Checking that the
+/// actor still follows it costs one interpolation.
+class TrajectoryPredictor {
+ public:
+  /// \brief Predict the trajectory of an actor again if needed.
+  /// \param[in] _params Prediction parameters.
+  /// \param[in] _kernel_params Motion parameters.
+  /// \param[in] _plan Plan of the actor.
+  /// \param[in] _state Pose of the actor at the given time.
+  /// \param[in] _time Simulation time of the pose, in seconds.
+  /// \return True if the trajectory was predicted again.
+  bool Update(const PredictionParams &_params,
+              const ActorKernelParams &_kernel_params,
+              const ActorPlan &_plan, const ActorStep &_state, double _time);
+
+  /// \brief Forget the prediction, so the next update predicts again.
+  void Clear() { this->valid_ = false; }
+
+  /// \brief Predicted poses, the first one at Start().
+  const std::vector<ActorStep> &Poses() const { return this->poses_; }
+
+  /// \brief Simulation time of the first predicted pose, in seconds.
+  double Start() const { return this->start_; }
+
+  /// \brief Fill a path message with the prediction, in the odometry
+  /// frame of the actor.
+  /// \param[in] _stamp Time stamp of the first predicted pose.
+  /// \param[in] _orientation Orientation of the actor, holding its
+  /// default rotation.
+  /// \param[in,out] _msg Path message, whose frame is given to its poses.
+  void Fill(const ros::Time &_stamp, ActorOrientation _orientation,
+            nav_msgs::Path &_msg) const;
+
+ private:
+  /// \brief Check whether the prediction still holds.
+  /// \param[in] _params Prediction parameters.
+  /// \param[in] _plan Plan of the actor.
+  /// \param[in] _state Pose of the actor at the given time.
+  /// \param[in] _time Simulation time of the pose, in seconds.
+  bool Holds(const PredictionParams &_params, const ActorPlan &_plan,
+             const ActorStep &_state, double _time) const;
+
+  /// \brief Whether a prediction has been made.
+  bool valid_ = false;
+
+  /// \brief Plan the prediction was made for.
+  ActorPlan plan_;
+
+  /// \brief Simulation time of the first predicted pose.
+  double start_ = 0;
+
+  /// \brief Time between two predicted poses.
+  double step_ = 0;
+
+  /// \brief Predicted poses.
+  std::vector<ActorStep> poses_;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_TRAJECTORY_PREDICTION
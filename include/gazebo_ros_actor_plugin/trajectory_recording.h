@@ -0,0 +1,224 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_TRAJECTORY_RECORDING
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_TRAJECTORY_RECORDING
+
+#include <sdf/Element.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gazebo_ros_actor_plugin/actor_state_store.h"
+
+namespace gazebo {
+
+/// \brief Parameters of the trajectory recording and replay.
+struct RecordingParams {
+  /// \brief Recording replayed by the actors in replay mode, empty for none.
+  std::string replay_file;
+
+  /// \brief Recording written with the poses of the actors, empty to
+  /// record nothing.
+  std::string record_file;
+
+  /// \brief Rate at which poses are recorded, 0 to record every update.
+  double record_rate = 30;
+};
+
+/// \brief Read the recording and replay parameters of a plugin.
+/// \param[in] _sdf Pointer to the plugin's SDF elements.
+/// \param[in,out] _params Parameters, left unchanged when not set.
+void LoadRecordingParams(const sdf::ElementPtr &_sdf,
+                         RecordingParams &_params);
+
+/// \brief Pose of an actor at a simulation time, as stored in a recording.
+struct RecordedPose {
+  /// \brief Simulation time in seconds.
+  double time;
+
+  /// \brief Position in the world frame.
+  double x;
+  double y;
+
+  /// \brief Heading of the actor, without the default rotation of its
+  /// skin, so a recording can be replayed with another skin.
+  double yaw;
+};
+
+/// \brief Layout of a recording file, in the byte order of the host: a
+/// header, one entry per actor, then the poses of each actor in turn,
+/// sorted by time.
+struct RecordingHeader {
+  /// \brief kMagic.
+  char magic[8];
+
+  /// \brief Number of actor entries following the header.
+  uint64_t actor_count;
+
+  /// \brief Identifies a recording, and the version of its layout.
+  static constexpr const char kMagic[8] = {'A', 'C', 'T', 'R',
+                                           'E', 'C', '0', '1'};
+};
+
+/// \brief Entry of an actor in a recording file.
+struct RecordingEntry {
+  /// \brief Size of the name field, its terminating null included.
+  static constexpr size_t kNameSize = 56;
+
+  /// \brief Name of the actor, null terminated.
+  char name[kNameSize];
+
+  /// \brief Index of the first pose of the actor among all poses.
+  uint64_t offset;
+
+  /// \brief Number of poses of the actor.
+  uint64_t count;
+};
+
+/// \brief Recorded trajectory of one actor, a view into its recording.
+class RecordedTrack {
+ public:
+  /// \brief Constructor of an empty track.
+  RecordedTrack() = default;
+
+  /// \brief Constructor
+  /// \param[in] _poses Poses sorted by time, which must outlive the track.
+  /// \param[in] _count Number of poses.
+  RecordedTrack(const RecordedPose *_poses, size_t _count)
+      : poses_(_poses), count_(_count) {}
+
+  /// \brief Whether the track has no pose.
+  bool Empty() const { return this->count_ == 0; }
+
+  /// \brief Number of poses.
+  size_t Size() const { return this->count_; }
+
+  /// \brief Pose of the actor at a time, interpolated between the
+  /// recorded poses around it. The actor stands at the first pose before
+  /// the track starts and at the last one once it ends.
+  /// \param[in] _time Simulation time in seconds.
+  /// \param[in] _default_rotation Default rotation of the actor skin,
+  /// added to the recorded heading.
+  /// \param[in,out] _hint Index of the pose sampled last, so that sampling
+  /// the track forward in time costs O(1).
+  /// \return Pose at the time, with the twist of the recorded segment.
+  ActorStep Sample(double _time, double _default_rotation,
+                   size_t &_hint) const;
+
+ private:
+  /// \brief Poses sorted by time.
+  const RecordedPose *poses_ = nullptr;
+
+  /// \brief Number of poses.
+  size_t count_ = 0;
+};
+
+/// \brief Recording file mapped in memory, read in place.
+///
+/// Opening a recording maps it and indexes its actors, the poses are only
+/// paged in as they are replayed, so even large recordings load at once.
+class TrajectoryRecording {
+ public:
+  /// \brief Get the recording of a file shared by the plugins of the
+  /// process, mapping it if needed.
+  /// \param[in] _path Path of the file.
+  /// \return Shared pointer to the recording, null if the file cannot be
+  /// read or is not a recording.
+  static std::shared_ptr<const TrajectoryRecording> Acquire(
+      const std::string &_path);
+
+  /// \brief Destructor, unmaps the file.
+  ~TrajectoryRecording();
+
+  TrajectoryRecording(const TrajectoryRecording &) = delete;
+  TrajectoryRecording &operator=(const TrajectoryRecording &) = delete;
+
+  /// \brief Trajectory of an actor.
+  /// \param[in] _name Name of the actor.
+  /// \return Its track, empty if the actor was not recorded.
+  RecordedTrack Track(const std::string &_name) const;
+
+  /// \brief Number of recorded actors.
+  size_t Size() const { return this->tracks_.size(); }
+
+ private:
+  /// \brief Constructor of an unmapped recording.
+  TrajectoryRecording() = default;
+
+  /// \brief Map and index a file.
+  /// \param[in] _path Path of the file.
+  /// \return False, with the reason reported, if it is not a recording.
+  bool Open(const std::string &_path);
+
+  /// \brief Mapped file, null when unmapped.
+  void *data_ = nullptr;
+
+  /// \brief Size of the mapping.
+  size_t size_ = 0;
+
+  /// \brief Track of each recorded actor by name.
+  std::unordered_map<std::string, RecordedTrack> tracks_;
+};
+
+/// \brief Poses of the actors of a live run, written to a recording file
+/// once the last plugin recording to it is unloaded.
+///
+/// A simulation time going back, as on a reset of the world, starts the
+/// recording over from that time, so the file holds the last run.
+class TrajectoryRecorder {
+ public:
+  /// \brief Get the recorder of a file shared by the plugins of the
+  /// process, creating it if needed. The shared recorder is only used from
+  /// the physics thread.
+  /// \param[in] _path Path of the file.
+  /// \param[in] _rate Rate at which poses are recorded, only used by the
+  /// call that creates the recorder.
+  /// \return Shared pointer to the recorder.
+  static std::shared_ptr<TrajectoryRecorder> Acquire(const std::string &_path,
+                                                     double _rate);
+
+  /// \brief Constructor
+  /// \param[in] _path Path of the file.
+  /// \param[in] _rate Rate at which poses are recorded, 0 for every call.
+  TrajectoryRecorder(const std::string &_path, double _rate);
+
+  /// \brief Destructor, writes the file.
+  ~TrajectoryRecorder();
+
+  /// \brief Add an actor to the recording.
+  /// \param[in] _name Name of the actor.
+  /// \return Track of the actor.
+  size_t Register(const std::string &_name);
+
+  /// \brief Record the pose of an actor, unless its last recorded pose is
+  /// more recent than the recording period.
+  /// \param[in] _track Track returned by Register().
+  /// \param[in] _time Simulation time in seconds.
+  /// \param[in] _x X position in the world frame.
+  /// \param[in] _y Y position in the world frame.
+  /// \param[in] _yaw Heading, without the default rotation of the skin.
+  void Add(size_t _track, double _time, double _x, double _y, double _yaw);
+
+  /// \brief Write the recording, replacing the file once it is complete.
+  /// \return False, with the reason reported, if it cannot be written.
+  bool Write() const;
+
+ private:
+  /// \brief Path of the file.
+  std::string path_;
+
+  /// \brief Time between two recorded poses of an actor.
+  double period_;
+
+  /// \brief Name of the actor of each track.
+  std::vector<std::string> names_;
+
+  /// \brief Recorded poses of each track.
+  std::vector<std::vector<RecordedPose>> tracks_;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_TRAJECTORY_RECORDING
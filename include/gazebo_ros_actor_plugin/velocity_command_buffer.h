@@ -0,0 +1,176 @@
+#ifndef GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_VELOCITY_COMMAND_BUFFER
+#define GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_VELOCITY_COMMAND_BUFFER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "gazebo_ros_actor_plugin/actor_diagnostics.h"
+#include "gazebo_ros_actor_plugin/spsc_ring.h"
+
+namespace gazebo {
+
+/// \brief Velocity command received from a ROS publisher.
+struct VelocityCommand {
+  /// \brief Linear velocity along the actor's heading.
+  double linear = 0;
+
+  /// \brief Angular velocity around the vertical axis.
+  double angular = 0;
+
+  /// \brief Simulation time from which the command applies, in seconds,
+  /// zero to apply it at the next update.
+  double stamp = 0;
+
+  /// \brief Wall time of the reception, zero for generated commands.
+  ACTOR_DIAG(double received = 0;)
+};
+
+/// \brief How queued velocity commands are consumed by the update thread.
+enum class CommandPolicy {
+  /// \brief Apply one command per update, dropping the oldest ones
+  /// when more than the queue size are pending.
+  FIFO,
+  /// \brief Apply only the newest pending command.
+  LATEST,
+  /// \brief Apply the newest command received at or before the
+  /// current simulation time.
+  STAMPED
+};
+
+/// \brief How velocity commands interact with the other modes.
+enum class CommandArbitration {
+  /// \brief Velocity commands are only followed in velocity mode.
+  NONE,
+  /// \brief A velocity command received in path or idle mode takes over
+  /// until no command is received for the preemption timeout.
+  VELOCITY_PREEMPTS
+};
+
+/// \brief Parse a command arbitration from its SDF name.
+/// \param[in] _name One of "none" or "velocity_preempts".
+/// \param[out] _arbitration Parsed arbitration.
+/// \return False if the name is unknown.
+bool ParseCommandArbitration(const std::string &_name,
+                             CommandArbitration &_arbitration);
+
+/// \brief Parse a command policy from its SDF name.
+/// \param[in] _name One of "fifo", "latest" or "stamped".
+/// \param[out] _policy Parsed policy.
+/// \return False if the name is unknown.
+bool ParseCommandPolicy(const std::string &_name, CommandPolicy &_policy);
+
+/// \brief Velocity commands handed from a ROS callback to the update thread.
+///
+/// Push is called by the callback and Next by the update thread, neither
+/// of them blocks. Memory use is bounded whatever the publishing rate: a
+/// command pushed while the ring is full goes to an overflow slot, served
+/// after the pending commands older than it. The commands overwritten in
+/// the slot before the update thread takes them are lost.
+class VelocityCommandBuffer {
+ public:
+  /// \brief Maximum number of commands waiting in the ring.
+  static constexpr size_t kCapacity = 64;
+
+  /// \brief Maximum queue size of the FIFO policy. Half the ring, so the
+  /// ring only overflows once the FIFO policy has dropped commands anyway.
+  static constexpr size_t kMaxQueueSize = kCapacity / 2;
+
+  /// \brief Set how commands are consumed.
+  /// \param[in] _policy Consumption policy.
+  /// \param[in] _queue_size Maximum number of pending commands kept by
+  /// the FIFO policy, clamped to kMaxQueueSize.
+  /// \param[in] _timeout Time without a new command after which the actor
+  /// is stopped, zero disables it.
+  void Configure(CommandPolicy _policy, size_t _queue_size, double _timeout);
+
+  /// \brief Add a command, called by the ROS callback.
+  /// \param[in] _cmd Received command.
+  /// \return False if the ring is full, and the command goes to the
+  /// overflow slot.
+  bool Push(const VelocityCommand &_cmd);
+
+  /// \brief Get the command to apply, called by the update thread.
+  /// \param[in] _now Current simulation time, in seconds.
+  /// \param[out] _cmd Command to apply from now on.
+  /// \return False if the command currently applied does not change.
+  bool Next(double _now, VelocityCommand &_cmd);
+
+  /// \brief Drop every pending command, called by the update thread.
+  void Clear();
+
+  /// \brief Simulation time at which Next() last returned a received
+  /// command, rather than the stop of a timeout, in seconds.
+  double LastApplied() const { return this->last_applied_; }
+
+  /// \brief Number of pending commands, called by the update thread.
+  size_t Size() const { return this->ring_.Size() + this->held_; }
+
+ private:
+  /// \brief Pending command, numbered in the order of the pushes.
+  struct Entry {
+    VelocityCommand cmd;
+    uint64_t sequence = 0;
+  };
+
+  /// \brief Take the command of the overflow slot if it was written since
+  /// it was last taken. A command still held from an earlier overflow is
+  /// dropped, with the pending commands older than it.
+  void TakeOverflow();
+
+  /// \brief Whether the held overflow command is the oldest pending one.
+  /// \param[in] _ring_front True if the ring has a command.
+  /// \param[in] _entry Oldest command of the ring.
+  bool HeldFirst(bool _ring_front, const Entry &_entry) const;
+
+  /// \brief Oldest pending command.
+  /// \param[out] _entry Oldest pending command.
+  /// \return False if no command is pending.
+  bool Front(Entry &_entry) const;
+
+  /// \brief Drop the oldest pending command.
+  void PopFront();
+
+  /// \brief Pending commands.
+  SpscRing<Entry, kCapacity> ring_;
+
+  /// \brief Number of commands pushed, written by the producer only.
+  uint64_t pushed_ = 0;
+
+  /// \brief Newest command pushed while the ring was full, guarded by a
+  /// sequence lock: overflow_version_ is odd while it is written.
+  std::atomic<uint64_t> overflow_version_{0};
+  std::atomic<double> overflow_linear_{0};
+  std::atomic<double> overflow_angular_{0};
+  std::atomic<double> overflow_stamp_{0};
+  std::atomic<uint64_t> overflow_sequence_{0};
+  ACTOR_DIAG(std::atomic<double> overflow_received_{0};)
+
+  /// \brief Version of the overflow slot taken last by the consumer.
+  uint64_t taken_version_ = 0;
+
+  /// \brief Command taken from the overflow slot and not consumed yet,
+  /// ordered with the ring by its sequence. Only used by the consumer.
+  Entry overflow_entry_;
+  bool held_ = false;
+
+  /// \brief Consumption policy.
+  CommandPolicy policy_ = CommandPolicy::FIFO;
+
+  /// \brief Maximum number of pending commands for the FIFO policy.
+  size_t queue_size_ = kMaxQueueSize;
+
+  /// \brief Command timeout, zero when disabled.
+  double timeout_ = 0;
+
+  /// \brief Simulation time at which the last command was applied.
+  double last_applied_ = 0;
+
+  /// \brief Whether a non timed out command is being applied.
+  bool active_ = false;
+};
+
+}  // namespace gazebo
+
+#endif  // GAZEBO_ROS_ACTOR_PLUGIN_INCLUDE_VELOCITY_COMMAND_BUFFER
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Generate the worlds of the scaling benchmark.
+
+Each world holds a grid of actors commanded either by a single crowd manager
+or by one actor plugin each, following velocity commands or paths. Actor i
+is named actor<i> and listens on actor<i>/cmd_vel and actor<i>/cmd_path.
+"""
+import argparse
+import math
+import os
+
+HEADER = """<?xml version="1.0" ?>
+<sdf version="1.5">
+  <world name="default">
+
+    <!-- A global light source -->
+    <include>
+      <uri>model://sun</uri>
+      <pose>0 0 0 0 0 0</pose>
+    </include>
+
+    <!-- A ground plane -->
+    <include>
+      <uri>model://ground_plane</uri>
+      <pose>0 0 0 0 0 0</pose>
+    </include>
+
+    <scene>
+      <shadows>false</shadows>
+    </scene>
+"""
+
+FOOTER = """
+  </world>
+</sdf>
+"""
+
+ACTOR = """
+    <actor name="{name}">
+      <pose>{x} {y} 1.2138 0 0 0</pose>
+      <skin>
+        <filename>moonwalk.dae</filename>
+        <scale>1.0</scale>
+      </skin>
+      <animation name="walking">
+        <filename>walk.dae</filename>
+        <scale>1.000000</scale>
+        <interpolate_x>true</interpolate_x>
+      </animation>{plugin}
+    </actor>
+"""
+
+PARAMETERS = """
+      <follow_mode>{mode}</follow_mode>
+      <vel_topic>{vel_topic}</vel_topic>
+      <path_topic>{path_topic}</path_topic>
+      <animation_factor>4.0</animation_factor>
+      <linear_tolerance>0.1</linear_tolerance>
+      <linear_velocity>1</linear_velocity>
+      <angular_tolerance>0.0872</angular_tolerance>
+      <angular_velocity>2.5</angular_velocity>
+      <default_rotation>1.57</default_rotation>"""
+
+ACTOR_PLUGIN = """
+      <plugin name="actor_plugin" filename="libgazebo_ros_actor_command.so">\
+{parameters}
+      </plugin>"""
+
+MANAGER_PLUGIN = """
+    <!-- Commands every actor above from a single plugin instance -->
+    <plugin name="crowd_manager" filename="libgazebo_ros_crowd_manager.so">\
+{parameters}
+    </plugin>
+"""
+
+MODES = ('velocity', 'path')
+PLUGINS = ('manager', 'actor')
+
+
+def actor_positions(count, spacing):
+    """Positions of the actors, on a square grid centred on the origin."""
+    columns = int(math.ceil(math.sqrt(count)))
+    offset = (columns - 1) * spacing / 2.0
+    return [((i % columns) * spacing - offset,
+             (i // columns) * spacing - offset) for i in range(count)]
+
+
+def world_name(plugin, mode, count):
+    return 'scaling_{}_{}_{}'.format(plugin, mode, count)
+
+
+def generate_world(plugin, mode, count, spacing):
+    """SDF of a world with count actors."""
+    sdf = HEADER
+    for i, (x, y) in enumerate(actor_positions(count, spacing)):
+        name = 'actor{}'.format(i)
+        actor_plugin = ''
+        if plugin == 'actor':
+            actor_plugin = ACTOR_PLUGIN.format(parameters=PARAMETERS.format(
+                mode=mode, vel_topic=name + '/cmd_vel',
+                path_topic=name + '/cmd_path').replace('\n', '\n  '))
+        sdf += ACTOR.format(name=name, x=x, y=y, plugin=actor_plugin)
+    if plugin == 'manager':
+        sdf += MANAGER_PLUGIN.format(parameters=PARAMETERS.format(
+            mode=mode, vel_topic='cmd_vel', path_topic='cmd_path'))
+    return sdf + FOOTER
+
+
+def write_world(directory, plugin, mode, count, spacing):
+    """Write a world in a directory and return its path."""
+    if not os.path.isdir(directory):
+        os.makedirs(directory)
+    path = os.path.join(directory, world_name(plugin, mode, count) + '.world')
+    with open(path, 'w') as world:
+        world.write(generate_world(plugin, mode, count, spacing))
+    return path
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--counts', type=int, nargs='+',
+                        default=[10, 50, 100, 500])
+    parser.add_argument('--modes', nargs='+', choices=MODES,
+                        default=list(MODES))
+    parser.add_argument('--plugin', choices=PLUGINS, default='manager',
+                        help='one crowd manager or one actor plugin per actor')
+    parser.add_argument('--spacing', type=float, default=4.0,
+                        help='distance between neighbouring actors [m]')
+    parser.add_argument('--output', default='scaling_worlds',
+                        help='directory the worlds are written to')
+    args = parser.parse_args()
+    for mode in args.modes:
+        for count in args.counts:
+            print(write_world(args.output, args.plugin, mode, count,
+                              args.spacing))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+"""Measure how gzserver scales with the number of actors.
+
+For each actor count and follow mode, a world is generated, simulated
+headless with scaling_benchmark.launch and loaded with velocity commands or
+paths on every actor. After a warm up, the real time factor and the CPU,
+thread count and memory of gzserver are sampled and written as one CSV row
+per configuration. A roscore must be running.
+"""
+import argparse
+import csv
+import math
+import os
+import signal
+import subprocess
+import time
+
+import rosgraph
+import rospy
+from geometry_msgs.msg import PoseStamped, Twist
+from nav_msgs.msg import Path
+from rosgraph_msgs.msg import Clock
+
+import generate_scaling_worlds as worlds
+
+FIELDS = ['plugin', 'mode', 'actors', 'rtf', 'rtf_min', 'cpu_percent',
+          'threads', 'rss_mb']
+
+
+class ClockMonitor(object):
+    """Latest simulation time published on /clock."""
+
+    def __init__(self):
+        self.sim_time = None
+        self.sub = rospy.Subscriber('/clock', Clock, self.callback,
+                                    queue_size=1)
+
+    def callback(self, msg):
+        self.sim_time = msg.clock.to_sec()
+
+
+class ProcessStats(object):
+    """CPU time, thread count and resident memory of a process, from /proc."""
+
+    def __init__(self, pid):
+        self.pid = pid
+        self.ticks = os.sysconf('SC_CLK_TCK')
+
+    def cpu_time(self):
+        with open('/proc/{}/stat'.format(self.pid)) as stat:
+            # The command name may contain spaces, skip past it
+            fields = stat.read().rsplit(')', 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) / float(self.ticks)
+
+    def status(self, key):
+        with open('/proc/{}/status'.format(self.pid)) as status:
+            for line in status:
+                if line.startswith(key + ':'):
+                    return int(line.split()[1])
+        return 0
+
+
+def find_gzserver(launch, timeout):
+    """Pid of the gzserver started by a roslaunch process."""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if launch.poll() is not None:
+            raise RuntimeError('roslaunch exited with {}'.format(
+                launch.returncode))
+        pids = subprocess.run(['pgrep', '-n', '-x', 'gzserver'],
+                              stdout=subprocess.PIPE,
+                              universal_newlines=True).stdout.split()
+        if pids:
+            return int(pids[0])
+        time.sleep(0.5)
+    raise RuntimeError('gzserver did not start')
+
+
+def circle_path(x, y, radius, waypoints):
+    """Closed path around a point, walked counterclockwise."""
+    path = Path()
+    path.header.frame_id = 'map'
+    for i in range(waypoints + 1):
+        angle = i * 2 * math.pi / waypoints
+        heading = angle + math.pi / 2
+        pose = PoseStamped()
+        pose.header.frame_id = 'map'
+        pose.pose.position.x = x + radius * math.cos(angle)
+        pose.pose.position.y = y + radius * math.sin(angle)
+        pose.pose.orientation.z = math.sin(heading / 2)
+        pose.pose.orientation.w = math.cos(heading / 2)
+        path.poses.append(pose)
+    return path
+
+
+class Load(object):
+    """Commands sent to every actor while measuring."""
+
+    def __init__(self, mode, count, spacing, args):
+        self.mode = mode
+        self.args = args
+        self.pubs = []
+        self.paths = []
+        self.twist = Twist()
+        self.twist.linear.x = args.linear
+        self.twist.angular.z = args.angular
+        for i, (x, y) in enumerate(worlds.actor_positions(count, spacing)):
+            name = 'actor{}'.format(i)
+            if mode == 'velocity':
+                self.pubs.append(rospy.Publisher(name + '/cmd_vel', Twist,
+                                                 queue_size=1))
+            else:
+                self.pubs.append(rospy.Publisher(name + '/cmd_path', Path,
+                                                 queue_size=1, latch=True))
+                self.paths.append(circle_path(x, y, spacing / 3.0,
+                                              args.waypoints))
+        self.next_path = 0.0
+
+    def publish(self, now):
+        if self.mode == 'velocity':
+            for pub in self.pubs:
+                pub.publish(self.twist)
+        elif now >= self.next_path:
+            # Paths are resent periodically, each replacing the one walked
+            for pub, path in zip(self.pubs, self.paths):
+                path.header.stamp = rospy.Time(0)
+                pub.publish(path)
+            self.next_path = now + self.args.path_period
+
+    def close(self):
+        for pub in self.pubs:
+            pub.unregister()
+
+
+def measure(plugin, mode, count, args):
+    """Simulate one configuration and return its CSV row."""
+    world = worlds.write_world(args.worlds, plugin, mode, count, args.spacing)
+    launch = subprocess.Popen(
+        ['roslaunch', 'gazebo_ros_actor_plugin', 'scaling_benchmark.launch',
+         'world_file:=' + world],
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+        preexec_fn=os.setsid)
+    clock = ClockMonitor()
+    load = None
+    try:
+        stats = ProcessStats(find_gzserver(launch, args.timeout))
+        deadline = time.time() + args.timeout
+        while clock.sim_time is None:
+            if time.time() > deadline:
+                raise RuntimeError('no /clock from gzserver')
+            time.sleep(0.1)
+        load = Load(mode, count, args.spacing, args)
+        period = 1.0 / args.rate
+        samples_threads, samples_rss = [], []
+
+        def run(duration, samples):
+            end = time.monotonic() + duration
+            last_wall, last_sim = time.monotonic(), clock.sim_time
+            next_sample = last_wall + 1.0
+            while time.monotonic() < end and not rospy.is_shutdown():
+                now = time.monotonic()
+                load.publish(now)
+                if samples is not None and now >= next_sample:
+                    sim = clock.sim_time
+                    samples.append((sim - last_sim) / (now - last_wall))
+                    samples_threads.append(stats.status('Threads'))
+                    samples_rss.append(stats.status('VmRSS'))
+                    last_wall, last_sim = now, sim
+                    next_sample = now + 1.0
+                time.sleep(max(0.0, period - (time.monotonic() - now)))
+
+        run(args.warmup, None)
+        wall, sim, cpu = time.monotonic(), clock.sim_time, stats.cpu_time()
+        rtf_samples = []
+        run(args.duration, rtf_samples)
+        wall = time.monotonic() - wall
+        return {
+            'plugin': plugin,
+            'mode': mode,
+            'actors': count,
+            'rtf': round((clock.sim_time - sim) / wall, 4),
+            'rtf_min': round(min(rtf_samples), 4) if rtf_samples else '',
+            'cpu_percent': round(100.0 * (stats.cpu_time() - cpu) / wall, 1),
+            'threads': max(samples_threads) if samples_threads else '',
+            'rss_mb': round(max(samples_rss) / 1024.0, 1)
+            if samples_rss else '',
+        }
+    finally:
+        if load is not None:
+            load.close()
+        clock.sub.unregister()
+        os.killpg(launch.pid, signal.SIGINT)
+        try:
+            launch.wait(args.timeout)
+        except subprocess.TimeoutExpired:
+            os.killpg(launch.pid, signal.SIGKILL)
+            launch.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--counts', type=int, nargs='+',
+                        default=[10, 50, 100, 500])
+    parser.add_argument('--modes', nargs='+', choices=worlds.MODES,
+                        default=list(worlds.MODES))
+    parser.add_argument('--plugin', choices=worlds.PLUGINS, default='manager',
+                        help='one crowd manager or one actor plugin per actor')
+    parser.add_argument('--spacing', type=float, default=4.0,
+                        help='distance between neighbouring actors [m]')
+    parser.add_argument('--duration', type=float, default=60.0,
+                        help='wall time measured per configuration [s]')
+    parser.add_argument('--warmup', type=float, default=10.0,
+                        help='wall time under load before measuring [s]')
+    parser.add_argument('--timeout', type=float, default=60.0,
+                        help='time allowed for gzserver to start or stop [s]')
+    parser.add_argument('--rate', type=float, default=10.0,
+                        help='rate of the velocity commands [Hz]')
+    parser.add_argument('--linear', type=float, default=0.5,
+                        help='commanded linear velocity [m/s]')
+    parser.add_argument('--angular', type=float, default=0.3,
+                        help='commanded angular velocity [rad/s]')
+    parser.add_argument('--waypoints', type=int, default=20,
+                        help='waypoints of each path')
+    parser.add_argument('--path_period', type=float, default=5.0,
+                        help='time between two paths to each actor [s]')
+    parser.add_argument('--output', default='scaling.csv',
+                        help='CSV file the results are appended to')
+    parser.add_argument('--worlds', default='scaling_worlds',
+                        help='directory the generated worlds are written to')
+    args = parser.parse_args()
+
+    if not rosgraph.is_master_online():
+        parser.error('no ROS master, start roscore first')
+    # The harness measures wall time, it must not follow /clock itself
+    rospy.set_param('/use_sim_time', False)
+    rospy.init_node('scaling_harness', disable_signals=True)
+
+    new_file = not os.path.exists(args.output)
+    with open(args.output, 'a') as output:
+        writer = csv.DictWriter(output, fieldnames=FIELDS)
+        if new_file:
+            writer.writeheader()
+        for mode in args.modes:
+            for count in args.counts:
+                row = measure(args.plugin, mode, count, args)
+                rospy.loginfo('%s', row)
+                writer.writerow(row)
+                output.flush()
+
+
+if __name__ == '__main__':
+    main()
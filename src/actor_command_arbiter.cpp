@@ -0,0 +1,237 @@
+#include <gazebo_ros_actor_plugin/actor_command_arbiter.h>
+
+#include <ros/console.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::Configure(const std::string &_name,
+                                    const ArbiterParams &_params) {
+  this->name_ = _name;
+  this->params_ = _params;
+  this->cmd_queue_.Configure(_params.policy, _params.queue_size,
+                             _params.command_timeout);
+}
+
+/////////////////////////////////////////////////
+bool ActorCommandArbiter::PushVelocity(const VelocityCommand &_cmd) {
+  // The velocity topic and the batched commands both push
+  std::lock_guard<std::mutex> lock(this->vel_push_mutex_);
+  return this->cmd_queue_.Push(_cmd);
+}
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::SetPath(const nav_msgs::Path::ConstPtr &_msg) {
+  // The path reads x, y and yaw of its targets straight from the message,
+  // so the poses are not copied, and its index reuses the memory of a
+  // path of the pool
+  std::lock_guard<std::mutex> lock(this->path_mutex_);
+  std::shared_ptr<ActorPath> path =
+      ActorPath::FromMessage(_msg, &this->path_pool_);
+  path->resume = this->params_.path_resume;
+  this->HandOverPath(path);
+}
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::UpdatePath(
+    const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &_msg) {
+  // Only the poses of the update are referenced, the rest of the path
+  // is shared with the latest one
+  std::lock_guard<std::mutex> lock(this->path_mutex_);
+  this->HandOverPath(
+      ActorPath::FromUpdate(this->latest_path_, _msg, &this->path_pool_));
+}
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::HandOverPath(
+    const std::shared_ptr<ActorPath> &_path) {
+  // A path the update thread has not picked up yet is replaced, so the
+  // new one has to resume the way the skipped one would have
+  ActorPathPtr skipped =
+      std::atomic_exchange(&this->pending_path_, ActorPathPtr());
+  if (skipped) _path->MergeResume(*skipped);
+  ACTOR_DIAG(_path->received = DiagnosticsClock();)
+
+  this->latest_path_ = _path;
+  this->abort_ = false;
+  std::atomic_store(&this->pending_path_, ActorPathPtr(_path));
+}
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::Abort(bool _abort) {
+  std::lock_guard<std::mutex> lock(this->path_mutex_);
+  if (_abort) this->latest_path_.reset();
+  this->abort_ = _abort;
+}
+
+/////////////////////////////////////////////////
+bool ActorCommandArbiter::RequestMode(const std::string &_name,
+                                      std::string &_message) {
+  ActorMode mode;
+  if (!ParseActorMode(_name, mode)) {
+    _message = "Unknown mode " + _name;
+    return false;
+  }
+  // Applied by the next update
+  this->requested_mode_ = mode;
+  _message = std::string("Switching to ") + ActorModeName(mode) + " mode";
+  return true;
+}
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::Reset(double _x, double _y, double _yaw) {
+  this->requested_mode_ = kNoModeRequest;
+  this->mode_ = this->params_.initial_mode;
+  this->preempted_ = false;
+  this->preempt_until_ = 0;
+
+  // Forget commands and velocity from before the reset
+  this->cmd_queue_.Clear();
+  this->linear_ = 0;
+  this->angular_ = 0;
+
+  // Initialize the path with the current pose
+  this->idx_ = 0;
+  this->progress_ = 0;
+  this->abort_ = false;
+  this->path_ = ActorPath::FromPose(_x, _y, _yaw);
+  std::atomic_store(&this->pending_path_, ActorPathPtr());
+  std::lock_guard<std::mutex> lock(this->path_mutex_);
+  this->latest_path_ = this->path_;
+}
+
+/////////////////////////////////////////////////
+bool ActorCommandArbiter::TakeRequestedMode(ActorMode &_mode) {
+  const uint8_t requested = this->requested_mode_.exchange(kNoModeRequest);
+  if (requested == kNoModeRequest) return false;
+  _mode = static_cast<ActorMode>(requested);
+  return true;
+}
+
+/////////////////////////////////////////////////
+void ActorCommandArbiter::SwitchMode(ActorMode _mode) {
+  if (_mode == this->mode_) return;
+
+  // Commands sent before the switch are not replayed
+  if (_mode == ACTOR_MODE_VELOCITY) {
+    this->cmd_queue_.Clear();
+    this->linear_ = 0;
+    this->angular_ = 0;
+  }
+
+  // A new mode starts without preemption
+  this->preempted_ = false;
+
+  ROS_INFO_NAMED("actor", "Actor %s switched to %s mode", this->name_.c_str(),
+                 ActorModeName(_mode));
+  this->mode_ = _mode;
+}
+
+/////////////////////////////////////////////////
+bool ActorCommandArbiter::PullVelocity(double _now) {
+  VelocityCommand vel_cmd;
+  if (!this->cmd_queue_.Next(_now, vel_cmd)) return false;
+  ACTOR_DIAG(if (this->diagnostics_ && vel_cmd.received > 0) {
+    this->diagnostics_->velocity_latency.Add(DiagnosticsClock() -
+                                             vel_cmd.received);
+  })
+  this->linear_ = vel_cmd.linear;
+  this->angular_ = vel_cmd.angular;
+  return this->cmd_queue_.LastApplied() == _now;
+}
+
+/////////////////////////////////////////////////
+bool ActorCommandArbiter::Arbitrate(double _now, double _x, double _y) {
+  if (this->mode_ == ACTOR_MODE_VELOCITY) {
+    this->PullVelocity(_now);
+    return true;
+  }
+  // Scripted and replayed actors ignore velocity commands
+  if (this->mode_ == ACTOR_MODE_SCRIPTED || this->mode_ == ACTOR_MODE_REPLAY ||
+      this->params_.arbitration == CommandArbitration::NONE) {
+    return false;
+  }
+
+  // Only a command applied at this tick is fresh, not one waiting for its
+  // stamp or dropped by the policy
+  const bool fresh = this->PullVelocity(_now);
+  if (!this->preempted_) {
+    if (!fresh) return false;
+    ROS_INFO_NAMED("actor", "Velocity commands preempt %s mode of actor %s",
+                   ActorModeName(this->mode_), this->name_.c_str());
+    this->preempted_ = true;
+  } else if (!fresh && _now >= this->preempt_until_) {
+    // Resume the mode where the actor now stands
+    ROS_INFO_NAMED("actor", "Actor %s resumes %s mode", this->name_.c_str(),
+                   ActorModeName(this->mode_));
+    this->preempted_ = false;
+    this->linear_ = 0;
+    this->angular_ = 0;
+    if (this->mode_ == ACTOR_MODE_PATH &&
+        this->params_.path_resume == ActorPath::RESUME_CLOSEST &&
+        !this->path_->Empty()) {
+      PathPoint closest = this->path_->ClosestPoint(_x, _y);
+      this->idx_ = closest.index;
+      this->progress_ = closest.s;
+    }
+    return false;
+  }
+
+  if (fresh) this->preempt_until_ = _now + this->params_.preempt_timeout;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool ActorCommandArbiter::PathTarget(double _now, double _x, double _y,
+                                     ignition::math::Vector3d &_target) {
+  // Pick up a path received since the last tick, once its stamp is
+  // reached in lockstep mode
+  ActorPathPtr new_path = TakePendingPath(
+      this->pending_path_, this->params_.lockstep ? _now : -1);
+  if (new_path) {
+    ACTOR_DIAG(if (this->diagnostics_ && new_path->received > 0) {
+      this->diagnostics_->path_latency.Add(DiagnosticsClock() -
+                                           new_path->received);
+    })
+    this->idx_ = new_path->ResumeIndex(this->idx_, _x, _y);
+    this->path_ = new_path;
+    if (this->params_.lookahead > 0 && !new_path->Empty()) {
+      this->progress_ =
+          new_path->resume == ActorPath::RESUME_CLOSEST
+              ? new_path->ClosestPoint(_x, _y).s
+              : std::min(this->progress_, new_path->ArcLength(this->idx_));
+    }
+  }
+
+  if (this->abort_ || this->path_->Empty()) {
+    // Drop the aborted path
+    if (!this->path_->Empty()) this->path_ = std::make_shared<ActorPath>();
+    this->idx_ = 0;
+    this->progress_ = 0;
+    return false;
+  }
+
+  const ActorPath &path = *this->path_;
+  if (this->params_.lookahead > 0 && path.Size() > 1) {
+    // Pure pursuit: aim at a point sliding along the path ahead of the
+    // actor
+    PathPoint point =
+        path.Lookahead(_x, _y, this->params_.lookahead, this->progress_);
+    this->idx_ = point.index;
+    _target.Set(point.x, point.y, point.yaw);
+  } else {
+    _target = path.At(this->idx_);
+  }
+
+  // Check if actor has reached current target position
+  if (std::hypot(_target.X() - _x, _target.Y() - _y) <
+      this->params_.lin_tolerance) {
+    // All targets have been accomplished, stop moving
+    if (this->idx_ + 1 >= path.Size()) return false;
+    _target = path.At(++this->idx_);
+  }
+  return true;
+}
@@ -0,0 +1,75 @@
+#include <gazebo_ros_actor_plugin/actor_command_router.h>
+
+#include <map>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+nav_msgs::Path::ConstPtr gazebo::CommandPath(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+    size_t _command) {
+  return nav_msgs::Path::ConstPtr(_msg, &_msg->commands[_command].path);
+}
+
+/////////////////////////////////////////////////
+double gazebo::CommandStamp(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+    bool _lockstep) {
+  // Unstamped commands apply from their arrival on
+  if (!_lockstep) return 0;
+  return _msg->header.stamp.toSec();
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorCommandRouter> ActorCommandRouter::Acquire(
+    const std::string &_topic) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<ActorCommandRouter>> instances;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<ActorCommandRouter> router = instances[_topic].lock();
+  if (!router) {
+    router = std::make_shared<ActorCommandRouter>(_topic);
+    instances[_topic] = router;
+  }
+  return router;
+}
+
+/////////////////////////////////////////////////
+ActorCommandRouter::ActorCommandRouter(const std::string &_topic)
+    : queue_(SharedCallbackQueue::Acquire(1)) {
+  ros::SubscribeOptions so = ros::SubscribeOptions::create<
+      gazebo_ros_actor_plugin::ActorCommandArray>(
+      _topic, 100, boost::bind(&ActorCommandRouter::Callback, this, _1),
+      ros::VoidPtr(), this->queue_->Queue());
+  this->sub_ = this->node_.subscribe(so);
+}
+
+/////////////////////////////////////////////////
+ActorCommandRouter::~ActorCommandRouter() {
+  // Drop the callback from the queue before the router goes away
+  this->sub_.shutdown();
+}
+
+/////////////////////////////////////////////////
+void ActorCommandRouter::Register(const std::string &_name,
+                                  Handler _handler) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->handlers_[_name] = std::move(_handler);
+}
+
+/////////////////////////////////////////////////
+void ActorCommandRouter::Unregister(const std::string &_name) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->handlers_.erase(_name);
+}
+
+/////////////////////////////////////////////////
+void ActorCommandRouter::Callback(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  for (size_t i = 0; i < _msg->commands.size(); ++i) {
+    auto handler = this->handlers_.find(_msg->commands[i].name);
+    if (handler != this->handlers_.end()) handler->second(_msg, i);
+  }
+}
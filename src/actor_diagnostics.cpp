@@ -0,0 +1,102 @@
+#include <gazebo_ros_actor_plugin/actor_diagnostics.h>
+
+#include <diagnostic_msgs/KeyValue.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gazebo;
+
+namespace {
+/// \brief Add a key value to a status.
+void AddValue(diagnostic_msgs::DiagnosticStatus &_status,
+              const std::string &_key, double _value) {
+  diagnostic_msgs::KeyValue kv;
+  kv.key = _key;
+  kv.value = std::to_string(_value);
+  _status.values.push_back(kv);
+}
+
+/// \brief Add a count to a status.
+void AddCount(diagnostic_msgs::DiagnosticStatus &_status,
+              const std::string &_key, uint64_t _count) {
+  diagnostic_msgs::KeyValue kv;
+  kv.key = _key;
+  kv.value = std::to_string(_count);
+  _status.values.push_back(kv);
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+void LatencyHistogram::Add(double _seconds) {
+  const double us = std::max(_seconds * 1e6, 0.0);
+  int exponent = 0;
+  std::frexp(us, &exponent);
+  const size_t bucket =
+      std::min<size_t>(std::max(exponent, 0), kBuckets - 1);
+  ++this->buckets_[bucket];
+  ++this->count_;
+  this->sum_ += _seconds;
+  this->max_ = std::max(this->max_, _seconds);
+}
+
+/////////////////////////////////////////////////
+double LatencyHistogram::Mean() const {
+  return this->count_ > 0 ? this->sum_ / this->count_ : 0.0;
+}
+
+/////////////////////////////////////////////////
+double LatencyHistogram::Quantile(double _q) const {
+  const double rank = _q * this->count_;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += this->buckets_[i];
+    if (seen > 0 && seen >= rank)
+      return std::min(std::ldexp(1e-6, static_cast<int>(i)), this->max_);
+  }
+  return this->max_;
+}
+
+/////////////////////////////////////////////////
+void LatencyHistogram::Clear() { *this = LatencyHistogram(); }
+
+/////////////////////////////////////////////////
+void SampleStats::Add(double _value) {
+  ++this->count;
+  this->sum += _value;
+  this->max = std::max(this->max, _value);
+}
+
+/////////////////////////////////////////////////
+void ActorDiagnostics::Fill(diagnostic_msgs::DiagnosticStatus &_status) const {
+  AddHistogram("update", this->update, _status);
+  AddHistogram("velocity_latency", this->velocity_latency, _status);
+  AddHistogram("path_latency", this->path_latency, _status);
+  AddHistogram("odom_publish", this->odom_publish, _status);
+  if (this->queue_depth.count > 0) {
+    AddValue(_status, "queue_depth_mean",
+             this->queue_depth.sum / this->queue_depth.count);
+    AddValue(_status, "queue_depth_max", this->queue_depth.max);
+  }
+}
+
+/////////////////////////////////////////////////
+void ActorDiagnostics::Clear() {
+  this->update.Clear();
+  this->velocity_latency.Clear();
+  this->path_latency.Clear();
+  this->odom_publish.Clear();
+  this->queue_depth.Clear();
+}
+
+/////////////////////////////////////////////////
+void gazebo::AddHistogram(const std::string &_name,
+                          const LatencyHistogram &_histogram,
+                          diagnostic_msgs::DiagnosticStatus &_status) {
+  if (_histogram.Count() == 0) return;
+  AddCount(_status, _name + "_count", _histogram.Count());
+  AddValue(_status, _name + "_mean_ms", _histogram.Mean() * 1e3);
+  AddValue(_status, _name + "_p50_ms", _histogram.Quantile(0.5) * 1e3);
+  AddValue(_status, _name + "_p99_ms", _histogram.Quantile(0.99) * 1e3);
+  AddValue(_status, _name + "_max_ms", _histogram.Max() * 1e3);
+}
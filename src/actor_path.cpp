@@ -0,0 +1,462 @@
+#include <gazebo_ros_actor_plugin/actor_path.h>
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+using namespace gazebo;
+
+namespace {
+/// \brief Number of segments above which a path is flattened into a single
+/// one, which bounds the cost of At() and of every further update.
+constexpr size_t kMaxSegments = 16;
+
+/// \brief Project a position on the line joining two poses of a path.
+/// \param[in] _path Path of the poses.
+/// \param[in] _line Index of the first pose of the line.
+/// \param[in] _x X position.
+/// \param[in] _y Y position.
+/// \param[in,out] _best Closest point so far, replaced if the projection
+/// is closer.
+void ProjectOnLine(const gazebo::ActorPath &_path, size_t _line, double _x,
+                   double _y, gazebo::PathPoint &_best) {
+  const geometry_msgs::Point &a = _path.Position(_line);
+  const geometry_msgs::Point &b = _path.Position(_line + 1);
+  const double dx = b.x - a.x;
+  const double dy = b.y - a.y;
+  const double len2 = dx * dx + dy * dy;
+  double t = len2 > 0 ? ((_x - a.x) * dx + (_y - a.y) * dy) / len2 : 0;
+  t = std::min(std::max(t, 0.0), 1.0);
+  const double px = a.x + t * dx;
+  const double py = a.y + t * dy;
+  const double d2 = (px - _x) * (px - _x) + (py - _y) * (py - _y);
+  if (d2 >= _best.distance2) return;
+
+  _best.x = px;
+  _best.y = py;
+  _best.index = t > 0 ? _line + 1 : _line;
+  _best.s = _path.ArcLength(_line) +
+            t * (_path.ArcLength(_line + 1) - _path.ArcLength(_line));
+  _best.distance2 = d2;
+}
+
+/// \brief Point of a single pose path.
+gazebo::PathPoint FirstPoint(const gazebo::ActorPath &_path, double _x,
+                             double _y) {
+  const geometry_msgs::Point &p = _path.Position(0);
+  gazebo::PathPoint point;
+  point.x = p.x;
+  point.y = p.y;
+  point.distance2 = (p.x - _x) * (p.x - _x) + (p.y - _y) * (p.y - _y);
+  return point;
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorPath> ActorPath::FromPose(double _x, double _y,
+                                               double _yaw) {
+  auto msg = boost::make_shared<nav_msgs::Path>();
+  msg->poses.resize(1);
+  geometry_msgs::Pose &pose = msg->poses[0].pose;
+  pose.position.x = _x;
+  pose.position.y = _y;
+  pose.orientation.z = std::sin(_yaw / 2);
+  pose.orientation.w = std::cos(_yaw / 2);
+  return FromMessage(msg);
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorPath> ActorPath::FromMessage(
+    const nav_msgs::Path::ConstPtr &_msg, ActorPathPool *_pool) {
+  auto path = _pool ? _pool->Acquire() : std::make_shared<ActorPath>();
+  path->stamp = _msg->header.stamp.toSec();
+  path->Append(_msg, _msg->poses.data(), _msg->poses.size());
+  path->BuildIndex(nullptr, 0);
+  return path;
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorPath> ActorPath::FromUpdate(
+    const std::shared_ptr<const ActorPath> &_base,
+    const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &_msg,
+    ActorPathPool *_pool) {
+  typedef gazebo_ros_actor_plugin::PathUpdate PathUpdate;
+  auto path = _pool ? _pool->Acquire() : std::make_shared<ActorPath>();
+  path->stamp = _msg->header.stamp.toSec();
+
+  // Keep the poses of the base path that are not replaced, by copying
+  // segment references only
+  size_t keep = 0;
+  if (_base && _msg->mode == PathUpdate::APPEND) {
+    keep = _base->Size();
+    path->resume = RESUME_KEEP;
+  } else if (_base && _msg->mode == PathUpdate::REPLACE_FROM) {
+    keep = std::min<size_t>(_msg->start, _base->Size());
+    path->resume = RESUME_FROM;
+    path->resume_index = keep;
+  } else if (_msg->mode == PathUpdate::RESUME_CLOSEST) {
+    path->resume = RESUME_CLOSEST;
+  }
+
+  for (size_t i = 0; i < (_base ? _base->segments.size() : 0); ++i) {
+    const size_t begin = i == 0 ? 0 : _base->ends[i - 1];
+    if (begin >= keep) break;
+    const Segment &segment = _base->segments[i];
+    path->Append(segment.owner, segment.poses,
+                 std::min(segment.size, keep - begin));
+  }
+  path->Append(_msg, _msg->poses.data(), _msg->poses.size());
+
+  // Flatten paths grown by many small updates
+  if (path->segments.size() > kMaxSegments) {
+    auto poses = boost::make_shared<std::vector<geometry_msgs::PoseStamped>>();
+    poses->reserve(path->Size());
+    for (const Segment &segment : path->segments)
+      poses->insert(poses->end(), segment.poses,
+                    segment.poses + segment.size);
+    path->segments.clear();
+    path->ends.clear();
+    path->Append(poses, poses->data(), poses->size());
+  }
+  path->BuildIndex(_base.get(), keep);
+  return path;
+}
+
+/////////////////////////////////////////////////
+void ActorPath::Clear() {
+  this->segments.clear();
+  this->ends.clear();
+  this->arc.clear();
+  this->grid.nx = 0;
+  this->grid.ny = 0;
+  this->grid.start.clear();
+  this->grid.lines.clear();
+  this->resume = RESUME_START;
+  this->resume_index = 0;
+  this->stamp = 0;
+  ACTOR_DIAG(this->received = 0;)
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d ActorPath::At(size_t _idx) const {
+  const size_t seg =
+      std::upper_bound(this->ends.begin(), this->ends.end(), _idx) -
+      this->ends.begin();
+  const size_t begin = seg == 0 ? 0 : this->ends[seg - 1];
+  const geometry_msgs::Pose &pose =
+      this->segments[seg].poses[_idx - begin].pose;
+  return ignition::math::Vector3d(pose.position.x, pose.position.y,
+                                  QuaternionToYaw(pose.orientation));
+}
+
+/////////////////////////////////////////////////
+const geometry_msgs::Point &ActorPath::Position(size_t _idx) const {
+  const size_t seg =
+      std::upper_bound(this->ends.begin(), this->ends.end(), _idx) -
+      this->ends.begin();
+  const size_t begin = seg == 0 ? 0 : this->ends[seg - 1];
+  return this->segments[seg].poses[_idx - begin].pose.position;
+}
+
+/////////////////////////////////////////////////
+PathPoint ActorPath::AtArcLength(double _s) const {
+  if (this->Size() < 2) {
+    PathPoint point = FirstPoint(*this, 0, 0);
+    point.yaw = this->At(0).Z();
+    return point;
+  }
+
+  // Line holding the arc length, the last one past the end of the path
+  const double s = std::min(std::max(_s, 0.0), this->Length());
+  size_t line = std::upper_bound(this->arc.begin(), this->arc.end(), s) -
+                this->arc.begin();
+  line = std::min(line, this->Size() - 1) - 1;
+
+  const geometry_msgs::Point &a = this->Position(line);
+  const geometry_msgs::Point &b = this->Position(line + 1);
+  const double len = this->arc[line + 1] - this->arc[line];
+  const double t = len > 0 ? (s - this->arc[line]) / len : 1;
+
+  PathPoint point;
+  point.x = a.x + t * (b.x - a.x);
+  point.y = a.y + t * (b.y - a.y);
+  point.s = s;
+  point.index = t > 0 ? line + 1 : line;
+  point.yaw = this->At(point.index).Z();
+  return point;
+}
+
+/////////////////////////////////////////////////
+PathPoint ActorPath::ClosestPoint(double _x, double _y) const {
+  if (this->Size() < 2) {
+    PathPoint point = FirstPoint(*this, _x, _y);
+    point.yaw = this->At(0).Z();
+    return point;
+  }
+
+  const Grid &grid = this->grid;
+  const long nx = grid.nx;
+  const long ny = grid.ny;
+  const long cx = std::min(
+      std::max(static_cast<long>(std::floor((_x - grid.min_x) / grid.cell)),
+               0L),
+      nx - 1);
+  const long cy = std::min(
+      std::max(static_cast<long>(std::floor((_y - grid.min_y) / grid.cell)),
+               0L),
+      ny - 1);
+
+  // Visit rings of cells around the position, until the next ring is
+  // farther than the closest point found
+  PathPoint best;
+  best.distance2 = std::numeric_limits<double>::infinity();
+  const long rings = std::max(nx, ny);
+  for (long r = 0; r <= rings; ++r) {
+    for (long y = cy - r; y <= cy + r; ++y) {
+      if (y < 0 || y >= ny) continue;
+      const bool edge = y == cy - r || y == cy + r;
+      for (long x = cx - r; x <= cx + r; x += edge ? 1 : 2 * r) {
+        if (x >= 0 && x < nx) {
+          const size_t c = y * nx + x;
+          for (uint32_t k = grid.start[c]; k < grid.start[c + 1]; ++k)
+            ProjectOnLine(*this, grid.lines[k], _x, _y, best);
+        }
+        if (r == 0) break;
+      }
+    }
+    const double reach = r * grid.cell;
+    if (best.distance2 <= reach * reach) break;
+  }
+  best.yaw = this->At(best.index).Z();
+  return best;
+}
+
+/////////////////////////////////////////////////
+PathPoint ActorPath::Project(double _x, double _y, double _s_min,
+                             double _s_max) const {
+  if (this->Size() < 2) {
+    PathPoint point = FirstPoint(*this, _x, _y);
+    point.yaw = this->At(0).Z();
+    return point;
+  }
+
+  // Lines overlapping the interval
+  const size_t last_line = this->Size() - 2;
+  size_t first = std::upper_bound(this->arc.begin(), this->arc.end(), _s_min) -
+                 this->arc.begin();
+  size_t last = std::upper_bound(this->arc.begin(), this->arc.end(), _s_max) -
+                this->arc.begin();
+  first = std::min(first == 0 ? 0 : first - 1, last_line);
+  last = std::min(last == 0 ? 0 : last - 1, last_line);
+
+  PathPoint best;
+  best.distance2 = std::numeric_limits<double>::infinity();
+  for (size_t line = first; line <= last; ++line)
+    ProjectOnLine(*this, line, _x, _y, best);
+  best.yaw = this->At(best.index).Z();
+  return best;
+}
+
+/////////////////////////////////////////////////
+PathPoint ActorPath::Lookahead(double _x, double _y, double _lookahead,
+                               double &_progress) const {
+  // Only look for the actor around its progress, so a path crossing
+  // itself does not make it skip a loop
+  const PathPoint reached =
+      this->Project(_x, _y, _progress, _progress + 2 * _lookahead);
+  _progress = std::max(_progress, reached.s);
+  return this->AtArcLength(_progress + _lookahead);
+}
+
+/////////////////////////////////////////////////
+size_t ActorPath::ResumeIndex(size_t _idx, double _x, double _y) const {
+  if (this->Empty()) return 0;
+  const size_t last = this->Size() - 1;
+  switch (this->resume) {
+    case RESUME_KEEP:
+      return std::min(_idx, last);
+    case RESUME_FROM:
+      return std::min(std::min(_idx, this->resume_index), last);
+    case RESUME_CLOSEST:
+      return this->ClosestPoint(_x, _y).index;
+    default:
+      return 0;
+  }
+}
+
+/////////////////////////////////////////////////
+void ActorPath::MergeResume(const ActorPath &_skipped) {
+  // A path replaced before it was followed only changes how this one
+  // resumes if this one is relative to it
+  if (this->resume == RESUME_KEEP) {
+    this->resume = _skipped.resume;
+    this->resume_index = _skipped.resume_index;
+  } else if (this->resume == RESUME_FROM) {
+    if (_skipped.resume == RESUME_START ||
+        _skipped.resume == RESUME_CLOSEST) {
+      this->resume = _skipped.resume;
+    } else if (_skipped.resume == RESUME_FROM) {
+      this->resume_index =
+          std::min(this->resume_index, _skipped.resume_index);
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+void ActorPath::Append(const boost::shared_ptr<const void> &_owner,
+                       const geometry_msgs::PoseStamped *_poses,
+                       size_t _size) {
+  if (_size == 0) return;
+  this->segments.push_back(Segment{_owner, _poses, _size});
+  this->ends.push_back(this->Size() + _size);
+}
+
+/////////////////////////////////////////////////
+void ActorPath::BuildIndex(const ActorPath *_base, size_t _shared) {
+  const size_t n = this->Size();
+
+  // The arc length of the shared poses does not change
+  this->arc.clear();
+  this->arc.reserve(n);
+  if (_base) {
+    this->arc.assign(_base->arc.begin(),
+                     _base->arc.begin() + std::min(_shared, n));
+  }
+  for (size_t i = this->arc.size(); i < n; ++i) {
+    if (i == 0) {
+      this->arc.push_back(0);
+      continue;
+    }
+    const geometry_msgs::Point &a = this->Position(i - 1);
+    const geometry_msgs::Point &b = this->Position(i);
+    this->arc.push_back(this->arc.back() + std::hypot(b.x - a.x, b.y - a.y));
+  }
+
+  // The vectors of the grid keep their memory from the last path built
+  Grid &grid = this->grid;
+  grid.nx = 0;
+  grid.ny = 0;
+  grid.start.clear();
+  grid.lines.clear();
+  if (n < 2) return;
+
+  // Cells about as large as the lines, and about as many as lines
+  double min_x = std::numeric_limits<double>::infinity();
+  double min_y = min_x;
+  double max_x = -min_x;
+  double max_y = -min_x;
+  for (const Segment &segment : this->segments) {
+    for (size_t i = 0; i < segment.size; ++i) {
+      const geometry_msgs::Point &p = segment.poses[i].pose.position;
+      min_x = std::min(min_x, p.x);
+      min_y = std::min(min_y, p.y);
+      max_x = std::max(max_x, p.x);
+      max_y = std::max(max_y, p.y);
+    }
+  }
+  const size_t lines = n - 1;
+  const double area = (max_x - min_x) * (max_y - min_y);
+  grid.cell = std::max({this->Length() / lines, std::sqrt(area / lines),
+                        1e-3});
+  grid.min_x = min_x;
+  grid.min_y = min_y;
+  grid.nx = static_cast<size_t>((max_x - min_x) / grid.cell) + 1;
+  grid.ny = static_cast<size_t>((max_y - min_y) / grid.cell) + 1;
+
+  // Visit the cells crossed by each line, column after column, once to
+  // count them and once to fill them in
+  auto cells = [&](size_t _line, auto &&_f) {
+    const geometry_msgs::Point &a = this->Position(_line);
+    const geometry_msgs::Point &b = this->Position(_line + 1);
+    const double lo_x = std::min(a.x, b.x);
+    const double hi_x = std::max(a.x, b.x);
+    const size_t cx0 = static_cast<size_t>((lo_x - grid.min_x) / grid.cell);
+    const size_t cx1 = static_cast<size_t>((hi_x - grid.min_x) / grid.cell);
+    for (size_t cx = cx0; cx <= cx1 && cx < grid.nx; ++cx) {
+      // Part of the line inside the column
+      const double xa = std::max(lo_x, grid.min_x + cx * grid.cell);
+      const double xb = std::min(hi_x, grid.min_x + (cx + 1) * grid.cell);
+      double ya = std::min(a.y, b.y);
+      double yb = std::max(a.y, b.y);
+      if (b.x != a.x) {
+        const double slope = (b.y - a.y) / (b.x - a.x);
+        ya = a.y + slope * (xa - a.x);
+        yb = a.y + slope * (xb - a.x);
+        if (ya > yb) std::swap(ya, yb);
+      }
+      const size_t cy0 = std::min(
+          static_cast<size_t>(std::max(ya - grid.min_y, 0.0) / grid.cell),
+          grid.ny - 1);
+      const size_t cy1 = std::min(
+          static_cast<size_t>(std::max(yb - grid.min_y, 0.0) / grid.cell),
+          grid.ny - 1);
+      for (size_t cy = cy0; cy <= cy1; ++cy) _f(cy * grid.nx + cx);
+    }
+  };
+
+  grid.start.assign(grid.nx * grid.ny + 1, 0);
+  for (size_t line = 0; line < lines; ++line)
+    cells(line, [&](size_t _c) { ++grid.start[_c + 1]; });
+  for (size_t c = 1; c < grid.start.size(); ++c)
+    grid.start[c] += grid.start[c - 1];
+
+  // Each cell is filled from its start, which then ends up at the start
+  // of the next cell and is shifted back
+  grid.lines.resize(grid.start.back());
+  for (size_t line = 0; line < lines; ++line) {
+    cells(line, [&](size_t _c) {
+      grid.lines[grid.start[_c]++] = static_cast<uint32_t>(line);
+    });
+  }
+  for (size_t c = grid.start.size() - 1; c > 0; --c)
+    grid.start[c] = grid.start[c - 1];
+  grid.start[0] = 0;
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorPath> ActorPathPool::Acquire() {
+  // Free paths release the messages they view, the first one is reused
+  std::shared_ptr<ActorPath> free;
+  for (std::shared_ptr<ActorPath> &path : this->paths_) {
+    if (path.use_count() != 1) continue;
+    // Whoever released the path last is done with it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    path->Clear();
+    if (!free) free = path;
+  }
+  if (free) return free;
+
+  free = std::make_shared<ActorPath>();
+  if (this->paths_.size() < kSize) this->paths_.push_back(free);
+  return free;
+}
+
+/////////////////////////////////////////////////
+ActorPathPtr gazebo::TakePendingPath(ActorPathPtr &_pending, double _now) {
+  if (_now < 0) return std::atomic_exchange(&_pending, ActorPathPtr());
+
+  // A newer path handed over in between stays in the slot, it is checked
+  // at the next update
+  ActorPathPtr path = std::atomic_load(&_pending);
+  if (!path || path->stamp > _now ||
+      !std::atomic_compare_exchange_strong(&_pending, &path, ActorPathPtr())) {
+    return ActorPathPtr();
+  }
+  return path;
+}
+
+/////////////////////////////////////////////////
+bool gazebo::ParsePathResume(const std::string &_name,
+                             ActorPath::Resume &_resume) {
+  if (_name == "start") {
+    _resume = ActorPath::RESUME_START;
+  } else if (_name == "closest") {
+    _resume = ActorPath::RESUME_CLOSEST;
+  } else {
+    return false;
+  }
+  return true;
+}
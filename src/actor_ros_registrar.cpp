@@ -0,0 +1,83 @@
+#include <gazebo_ros_actor_plugin/actor_ros_registrar.h>
+
+#include <algorithm>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorRosRegistrar> ActorRosRegistrar::Acquire(
+    unsigned int _threads) {
+  static std::mutex mutex;
+  static std::weak_ptr<ActorRosRegistrar> instance;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<ActorRosRegistrar> registrar = instance.lock();
+  if (!registrar) {
+    registrar = std::make_shared<ActorRosRegistrar>(_threads);
+    instance = registrar;
+  }
+  return registrar;
+}
+
+/////////////////////////////////////////////////
+ActorRosRegistrar::ActorRosRegistrar(unsigned int _threads) {
+  for (unsigned int i = 0; i < std::max(_threads, 1u); ++i)
+    this->workers_.emplace_back(&ActorRosRegistrar::Work, this);
+}
+
+/////////////////////////////////////////////////
+ActorRosRegistrar::~ActorRosRegistrar() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->stop_ = true;
+    this->jobs_.clear();
+  }
+  this->wake_.notify_all();
+  for (std::thread &worker : this->workers_) worker.join();
+}
+
+/////////////////////////////////////////////////
+void ActorRosRegistrar::Add(const void *_owner, Job _job) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->jobs_.emplace_back(_owner, std::move(_job));
+  }
+  this->wake_.notify_one();
+}
+
+/////////////////////////////////////////////////
+void ActorRosRegistrar::Cancel(const void *_owner) {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  this->jobs_.erase(
+      std::remove_if(this->jobs_.begin(), this->jobs_.end(),
+                     [_owner](const std::pair<const void *, Job> &_job) {
+                       return _job.first == _owner;
+                     }),
+      this->jobs_.end());
+  // A running registration still uses the plugin
+  this->done_.wait(lock, [this, _owner] {
+    return std::find(this->running_.begin(), this->running_.end(),
+                     _owner) == this->running_.end();
+  });
+}
+
+/////////////////////////////////////////////////
+void ActorRosRegistrar::Work() {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  for (;;) {
+    this->wake_.wait(lock,
+                     [this] { return this->stop_ || !this->jobs_.empty(); });
+    if (this->stop_) return;
+    std::pair<const void *, Job> job = std::move(this->jobs_.front());
+    this->jobs_.pop_front();
+    this->running_.push_back(job.first);
+
+    // Registrations wait on the master, the others go on meanwhile
+    lock.unlock();
+    job.second();
+    lock.lock();
+    this->running_.erase(
+        std::find(this->running_.begin(), this->running_.end(), job.first));
+    this->done_.notify_all();
+  }
+}
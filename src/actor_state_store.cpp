@@ -0,0 +1,306 @@
+#include <gazebo_ros_actor_plugin/actor_state_store.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gazebo;
+
+namespace {
+constexpr double kEpsilon = 1e-300;
+
+/// \brief sin(_x) / _x, continuous at zero.
+inline double Sinc(double _x) {
+  return _x * _x > 1e-8 ? std::cos(_x - M_PI_2) / _x : 1.0 - _x * _x / 6;
+}
+
+/// \brief Wrap an angle to [-pi, pi) without branching, so the kernel loop
+/// vectorizes. Only for the kernel, whose angles are sums of a few wrapped
+/// ones: the angle has to be finite and within the range of int turns.
+/// \param[in] _angle Angle, in radians.
+inline double WrapAngleKernel(double _angle) {
+  constexpr double kTwoPi = 2.0 * M_PI;
+  // Floor within the range of int: std::floor only has a vector form from
+  // SSE4.1 on, a truncating conversion is baseline SSE2
+  const double turns = _angle * (1.0 / kTwoPi) + 0.5;
+  const double truncated = static_cast<double>(static_cast<int>(turns));
+  return _angle - kTwoPi * (truncated - (turns < truncated ? 1.0 : 0.0));
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+bool gazebo::ParseActorMode(const std::string &_name, ActorMode &_mode) {
+  for (ActorMode mode : {ACTOR_MODE_IDLE, ACTOR_MODE_VELOCITY, ACTOR_MODE_PATH,
+                         ACTOR_MODE_SCRIPTED, ACTOR_MODE_REPLAY}) {
+    if (_name == ActorModeName(mode)) {
+      _mode = mode;
+      return true;
+    }
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+const char *gazebo::ActorModeName(ActorMode _mode) {
+  switch (_mode) {
+    case ACTOR_MODE_VELOCITY:
+      return "velocity";
+    case ACTOR_MODE_PATH:
+      return "path";
+    case ACTOR_MODE_SCRIPTED:
+      return "scripted";
+    case ACTOR_MODE_REPLAY:
+      return "replay";
+    default:
+      return "idle";
+  }
+}
+
+/////////////////////////////////////////////////
+size_t ActorStateStore::Add(double _x, double _y, double _z, double _yaw) {
+  const size_t idx = this->Size();
+  this->x.push_back(_x);
+  this->y.push_back(_y);
+  this->z.push_back(_z);
+  this->yaw.push_back(_yaw);
+  this->v.push_back(0);
+  this->w.push_back(0);
+  this->target_x.push_back(_x);
+  this->target_y.push_back(_y);
+  this->target_yaw.push_back(_yaw);
+  this->has_target.push_back(0);
+  this->mode.push_back(ACTOR_MODE_IDLE);
+  this->vel_x.push_back(0);
+  this->vel_y.push_back(0);
+  this->vel_yaw.push_back(0);
+  this->travelled.push_back(0);
+  this->start_x.push_back(_x);
+  this->start_y.push_back(_y);
+  this->start_yaw.push_back(_yaw);
+  return idx;
+}
+
+/////////////////////////////////////////////////
+void ActorStateStore::Stop(size_t _idx) {
+  this->v[_idx] = 0;
+  this->w[_idx] = 0;
+  this->target_x[_idx] = this->x[_idx];
+  this->target_y[_idx] = this->y[_idx];
+  this->target_yaw[_idx] = this->yaw[_idx];
+  this->has_target[_idx] = 0;
+  this->vel_x[_idx] = 0;
+  this->vel_y[_idx] = 0;
+  this->vel_yaw[_idx] = 0;
+  this->travelled[_idx] = 0;
+}
+
+/////////////////////////////////////////////////
+ActorStep ActorStateStore::Interpolate(size_t _idx, double _alpha) const {
+  const ActorStep from = {this->start_x[_idx], this->start_y[_idx],
+                          this->start_yaw[_idx], 0, 0, 0};
+  const ActorStep to = {this->x[_idx], this->y[_idx], this->yaw[_idx],
+                        this->vel_x[_idx], this->vel_y[_idx],
+                        this->vel_yaw[_idx]};
+  return InterpolateStep(from, to, _alpha);
+}
+
+/////////////////////////////////////////////////
+bool ActorStateStore::Still(size_t _idx) const {
+  return this->x[_idx] == this->start_x[_idx] &&
+         this->y[_idx] == this->start_y[_idx] &&
+         this->yaw[_idx] == this->start_yaw[_idx] &&
+         this->vel_x[_idx] == 0 && this->vel_y[_idx] == 0 &&
+         this->vel_yaw[_idx] == 0;
+}
+
+/////////////////////////////////////////////////
+ActorStep gazebo::InterpolateStep(const ActorStep &_from, const ActorStep &_to,
+                                  double _alpha) {
+  if (_alpha >= 1) return _to;
+  ActorStep step = _to;
+  step.x = _from.x + _alpha * (_to.x - _from.x);
+  step.y = _from.y + _alpha * (_to.y - _from.y);
+  step.yaw = WrapAngle(_from.yaw + _alpha * WrapAngle(_to.yaw - _from.yaw));
+  return step;
+}
+
+/////////////////////////////////////////////////
+bool gazebo::IsStill(const ActorStep &_from, const ActorStep &_to) {
+  return _to.x == _from.x && _to.y == _from.y && _to.yaw == _from.yaw &&
+         _to.vx == 0 && _to.vy == 0 && _to.wz == 0;
+}
+
+/////////////////////////////////////////////////
+void gazebo::UpdateActorStates(ActorStateStore &_store,
+                               const ActorKernelParams &_params, double _dt) {
+  UpdateActorStates(_store, _params, _dt, 0, _store.Size());
+}
+
+/////////////////////////////////////////////////
+void gazebo::UpdateActorStates(ActorStateStore &_store,
+                               const ActorKernelParams &_params, double _dt,
+                               size_t _begin, size_t _end) {
+  double *__restrict x = _store.x.data();
+  double *__restrict y = _store.y.data();
+  double *__restrict yaw = _store.yaw.data();
+  const double *__restrict v = _store.v.data();
+  const double *__restrict w = _store.w.data();
+  const double *__restrict tx = _store.target_x.data();
+  const double *__restrict ty = _store.target_y.data();
+  const uint8_t *__restrict has_target = _store.has_target.data();
+  const uint8_t *__restrict mode = _store.mode.data();
+  double *__restrict vel_x = _store.vel_x.data();
+  double *__restrict vel_y = _store.vel_y.data();
+  double *__restrict vel_yaw = _store.vel_yaw.data();
+  double *__restrict travelled = _store.travelled.data();
+  double *__restrict start_x = _store.start_x.data();
+  double *__restrict start_y = _store.start_y.data();
+  double *__restrict start_yaw = _store.start_yaw.data();
+
+  const double lin = _params.lin_velocity;
+  const double ang = _params.ang_velocity;
+  const double tol = _params.ang_tolerance;
+  const double rot = _params.default_rotation;
+  const double inv_dt = _dt > 0 ? 1.0 / _dt : 0.0;
+
+  // Both motion models are evaluated for every actor and blended by
+  // mode masks, so the loop body has no data dependent branches and the
+  // compiler can vectorize it, including the trigonometric calls.
+#pragma omp simd
+  for (size_t i = _begin; i < _end; ++i) {
+    const double is_path = mode[i] == ACTOR_MODE_PATH ? 1.0 : 0.0;
+    const double is_vel = mode[i] == ACTOR_MODE_VELOCITY ? 1.0 : 0.0;
+
+    // Path following: unit direction towards the target
+    const double dx = tx[i] - x[i];
+    const double dy = ty[i] - y[i];
+    const double dist = std::sqrt(dx * dx + dy * dy);
+    const double active = (has_target[i] != 0) & (dist > 0) ? 1.0 : 0.0;
+    const double inv_dist = active / (dist + kEpsilon);
+    const double ux = dx * inv_dist;
+    const double uy = dy * inv_dist;
+
+    // Angular displacement required to face the target
+    const double err =
+        active * WrapAngleKernel(std::atan2(dy, dx) + rot - yaw[i]);
+    const double walk = std::abs(err) > tol ? 0.0 : 1.0;
+
+    // The turn is bounded by the angular velocity and the walk by the
+    // distance to the target, so a long time step does not overshoot
+    const double max_turn = ang * _dt;
+    const double path_dyaw = std::min(std::max(err, -max_turn), max_turn);
+    const double path_speed = walk * std::min(lin, dist * inv_dt);
+    const double path_vx = ux * path_speed;
+    const double path_vy = uy * path_speed;
+    const double path_wz = path_dyaw * inv_dt;
+
+    // Exact integration along the arc of constant velocities: the chord
+    // follows the heading halfway through the step, shortened by the sinc
+    // of the half turn
+    const double half_turn = 0.5 * w[i] * _dt;
+    const double heading = yaw[i] - rot + half_turn;
+    const double chord = v[i] * Sinc(half_turn);
+    const double vel_vx = chord * std::cos(heading);
+    // sin is taken as a shifted cos, which keeps the compiler from fusing
+    // both calls into a sincos that has no vector variant
+    const double vel_vy = chord * std::cos(heading - M_PI_2);
+
+    const double out_vx = is_path * path_vx + is_vel * vel_vx;
+    const double out_vy = is_path * path_vy + is_vel * vel_vy;
+    const double out_dyaw = is_path * path_dyaw + is_vel * w[i] * _dt;
+    const double out_wz = is_path * path_wz + is_vel * w[i];
+
+    const double step_x = out_vx * _dt;
+    const double step_y = out_vy * _dt;
+    start_x[i] = x[i];
+    start_y[i] = y[i];
+    start_yaw[i] = yaw[i];
+    x[i] += step_x;
+    y[i] += step_y;
+    yaw[i] = WrapAngleKernel(yaw[i] + out_dyaw);
+
+    vel_x[i] = out_vx;
+    vel_y[i] = out_vy;
+    vel_yaw[i] = out_wz;
+    travelled[i] = std::sqrt(step_x * step_x + step_y * step_y);
+  }
+}
+
+/////////////////////////////////////////////////
+ActorStep gazebo::StepTowards(double _x, double _y, double _yaw, double _tx,
+                              double _ty, const ActorKernelParams &_params,
+                              double _dt) {
+  ActorStep step = {_x, _y, _yaw, 0, 0, 0};
+  const double dx = _tx - _x;
+  const double dy = _ty - _y;
+  const double dist = std::sqrt(dx * dx + dy * dy);
+  if (dist <= 0) return step;
+
+  // Angular displacement required to face the target, turned at most at
+  // the angular velocity
+  const double err =
+      WrapAngle(std::atan2(dy, dx) + _params.default_rotation - _yaw);
+  const double max_turn = _params.ang_velocity * _dt;
+  const double turn = std::min(std::max(err, -max_turn), max_turn);
+  step.yaw = WrapAngle(_yaw + turn);
+  step.wz = _dt > 0 ? turn / _dt : 0.0;
+  if (std::abs(err) > _params.ang_tolerance || _dt <= 0) return step;
+
+  // Facing the target, walk towards it without passing it
+  const double speed = std::min(_params.lin_velocity, dist / _dt);
+  step.vx = dx / dist * speed;
+  step.vy = dy / dist * speed;
+  step.x = _x + step.vx * _dt;
+  step.y = _y + step.vy * _dt;
+  return step;
+}
+
+/////////////////////////////////////////////////
+ActorStep gazebo::StepVelocity(double _x, double _y, double _yaw, double _v,
+                               double _w, const ActorKernelParams &_params,
+                               double _dt) {
+  // Chord of the arc of constant velocities
+  const double half_turn = 0.5 * _w * _dt;
+  const double heading = _yaw - _params.default_rotation + half_turn;
+  const double chord = _v * Sinc(half_turn);
+  ActorStep step;
+  step.vx = chord * std::cos(heading);
+  step.vy = chord * std::sin(heading);
+  step.wz = _w;
+  step.x = _x + step.vx * _dt;
+  step.y = _y + step.vy * _dt;
+  step.yaw = WrapAngle(_yaw + _w * _dt);
+  return step;
+}
+
+/////////////////////////////////////////////////
+void ControlClock::Configure(double _rate) {
+  this->period_ = _rate > 0 ? 1.0 / _rate : 0.0;
+  this->start_ = -1;
+}
+
+/////////////////////////////////////////////////
+bool ControlClock::Tick(double _now, double _dt, double &_control_dt) {
+  if (this->period_ <= 0) {
+    this->start_ = _now;
+    _control_dt = _dt;
+    return true;
+  }
+
+  const bool started = this->start_ >= 0 && _now >= this->start_;
+  const double elapsed = _now - this->start_;
+  if (started && elapsed < this->period_) return false;
+
+  // Ticks keep their phase, unless the update fell more than a period
+  // behind or the simulation time went back
+  this->start_ = started && elapsed < 2 * this->period_
+                     ? this->start_ + this->period_
+                     : _now;
+  _control_dt = this->period_;
+  return true;
+}
+
+/////////////////////////////////////////////////
+double ControlClock::Alpha(double _now) const {
+  if (this->period_ <= 0) return 1.0;
+  return std::min(std::max((_now - this->start_) / this->period_, 0.0), 1.0);
+}
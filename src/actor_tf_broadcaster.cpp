@@ -0,0 +1,69 @@
+#include <gazebo_ros_actor_plugin/actor_tf_broadcaster.h>
+
+#include <mutex>
+
+#include "gazebo_ros_actor_plugin/reusable_message.h"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+std::shared_ptr<ActorTfBroadcaster> ActorTfBroadcaster::Acquire(
+    double _rate) {
+  static std::mutex mutex;
+  static std::weak_ptr<ActorTfBroadcaster> instance;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<ActorTfBroadcaster> broadcaster = instance.lock();
+  if (!broadcaster) {
+    broadcaster = std::make_shared<ActorTfBroadcaster>(_rate);
+    instance = broadcaster;
+  }
+  return broadcaster;
+}
+
+/////////////////////////////////////////////////
+ActorTfBroadcaster::ActorTfBroadcaster(double _rate) : rate_(_rate) {
+  this->pub_ = this->node_.advertise<tf2_msgs::TFMessage>("/tf", 100);
+  this->connection_ = event::Events::ConnectWorldUpdateEnd(
+      std::bind(&ActorTfBroadcaster::Flush, this));
+}
+
+/////////////////////////////////////////////////
+bool ActorTfBroadcaster::Due(double _now) {
+  if (_now != this->checked_) {
+    this->checked_ = _now;
+    // Broadcasts start over when the time goes back
+    this->due_ = this->pub_.getNumSubscribers() > 0 &&
+                 (this->rate_ <= 0 || this->last_ < 0 || _now < this->last_ ||
+                  _now - this->last_ >= 1.0 / this->rate_);
+    if (this->due_) this->last_ = _now;
+  }
+  return this->due_;
+}
+
+/////////////////////////////////////////////////
+void ActorTfBroadcaster::Add(const std::string &_parent,
+                             const std::string &_child,
+                             const ros::Time &_stamp, double _x, double _y,
+                             const geometry_msgs::Quaternion &_rotation) {
+  // The transforms of the last batch are overwritten in place, so their
+  // frame names keep their memory
+  if (this->count_ == 0) ReusableMessage(this->msg_);
+  tf2_msgs::TFMessage &msg = *this->msg_;
+  if (this->count_ == msg.transforms.size()) msg.transforms.emplace_back();
+  geometry_msgs::TransformStamped &tf = msg.transforms[this->count_++];
+  tf.header.stamp = _stamp;
+  tf.header.frame_id = _parent;
+  tf.child_frame_id = _child;
+  tf.transform.translation.x = _x;
+  tf.transform.translation.y = _y;
+  tf.transform.rotation = _rotation;
+}
+
+/////////////////////////////////////////////////
+void ActorTfBroadcaster::Flush() {
+  if (this->count_ == 0) return;
+  this->msg_->transforms.resize(this->count_);
+  this->count_ = 0;
+  this->pub_.publish(this->msg_);
+}
@@ -0,0 +1,38 @@
+#include <gazebo_ros_actor_plugin/actor_trajectories.h>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+void gazebo::LoadAnimationNames(const sdf::ElementPtr &_sdf,
+                                AnimationNames &_names) {
+  if (_sdf->HasElement("walking_animation")) {
+    _names.walking = _sdf->Get<std::string>("walking_animation");
+  }
+  if (_sdf->HasElement("standing_animation")) {
+    _names.standing = _sdf->Get<std::string>("standing_animation");
+  }
+}
+
+/////////////////////////////////////////////////
+bool ActorTrajectories::Resolve(const physics::ActorPtr &_actor,
+                                const AnimationNames &_names) {
+  std::array<const std::string *, 2> names;
+  names[ANIMATION_STANDING] = &_names.standing;
+  names[ANIMATION_WALKING] = &_names.walking;
+
+  const auto &animations = _actor->SkeletonAnimations();
+  for (const std::string *name : names) {
+    if (animations.find(*name) == animations.end()) {
+      gzerr << "Skeleton animation " << *name << " not found for "
+            << _actor->GetName() << ".\n";
+      this->trajectories_ = {};
+      return false;
+    }
+  }
+  for (size_t i = 0; i < names.size(); ++i) {
+    this->trajectories_[i].reset(new physics::TrajectoryInfo());
+    this->trajectories_[i]->type = *names[i];
+    this->trajectories_[i]->duration = 1.0;
+  }
+  return true;
+}
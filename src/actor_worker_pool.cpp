@@ -0,0 +1,70 @@
+#include <gazebo_ros_actor_plugin/actor_worker_pool.h>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+ActorWorkerPool::ActorWorkerPool(unsigned int _threads) {
+  if (_threads == 0)
+    _threads = std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned int i = 1; i < _threads; ++i)
+    this->workers_.emplace_back(&ActorWorkerPool::Work, this);
+}
+
+/////////////////////////////////////////////////
+ActorWorkerPool::~ActorWorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->stop_ = true;
+  }
+  this->wake_.notify_all();
+  for (std::thread &worker : this->workers_) worker.join();
+}
+
+/////////////////////////////////////////////////
+void ActorWorkerPool::Run(size_t _n, size_t _grain, Task _task, void *_ctx) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->task_ = _task;
+    this->ctx_ = _ctx;
+    this->n_ = _n;
+    this->grain_ = _grain;
+    this->next_.store(0, std::memory_order_relaxed);
+    this->busy_ = this->workers_.size();
+    ++this->generation_;
+  }
+  this->wake_.notify_all();
+
+  this->Drain();
+
+  // The context lives on the stack of the caller, which must not return
+  // while a worker may still use it
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  this->done_.wait(lock, [this] { return this->busy_ == 0; });
+}
+
+/////////////////////////////////////////////////
+void ActorWorkerPool::Drain() {
+  for (;;) {
+    const size_t begin =
+        this->next_.fetch_add(this->grain_, std::memory_order_relaxed);
+    if (begin >= this->n_) return;
+    this->task_(this->ctx_, begin, std::min(begin + this->grain_, this->n_));
+  }
+}
+
+/////////////////////////////////////////////////
+void ActorWorkerPool::Work() {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  for (;;) {
+    this->wake_.wait(
+        lock, [&] { return this->stop_ || this->generation_ != seen; });
+    if (this->stop_) return;
+    seen = this->generation_;
+
+    lock.unlock();
+    this->Drain();
+    lock.lock();
+    if (--this->busy_ == 0) this->done_.notify_one();
+  }
+}
@@ -0,0 +1,106 @@
+#include <gazebo_ros_actor_plugin/animation_lod.h>
+
+#include <map>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+void gazebo::LoadAnimationLodParams(const sdf::ElementPtr &_sdf,
+                                    AnimationLodParams &_params) {
+  if (_sdf->HasElement("animation_lod_distance")) {
+    _params.distance = _sdf->Get<double>("animation_lod_distance");
+  }
+  if (_sdf->HasElement("animation_lod_rate")) {
+    _params.rate = _sdf->Get<double>("animation_lod_rate");
+  }
+  if (_sdf->HasElement("animation_lod_reference")) {
+    _params.reference = _sdf->Get<std::string>("animation_lod_reference");
+  }
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<AnimationLodReference> AnimationLodReference::Acquire(
+    const physics::WorldPtr &_world, const std::string &_name) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<AnimationLodReference>>
+      instances;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<AnimationLodReference> reference = instances[_name].lock();
+  if (!reference) {
+    reference = std::make_shared<AnimationLodReference>(_world, _name);
+    instances[_name] = reference;
+  }
+  return reference;
+}
+
+/////////////////////////////////////////////////
+AnimationLodReference::AnimationLodReference(const physics::WorldPtr &_world,
+                                             const std::string &_name)
+    : world_(_world), name_(_name) {
+  if (this->name_ != kUserCamera) return;
+  this->node_ = transport::NodePtr(new transport::Node());
+  this->node_->Init(this->world_->Name());
+  this->camera_sub_ = this->node_->Subscribe(
+      "~/user_camera/pose", &AnimationLodReference::OnCameraPose, this);
+}
+
+/////////////////////////////////////////////////
+bool AnimationLodReference::Position(double _now,
+                                     ignition::math::Vector3d &_position) {
+  if (_now != this->read_time_) {
+    this->read_time_ = _now;
+    if (this->node_) {
+      std::lock_guard<std::mutex> lock(this->camera_mutex_);
+      this->valid_ = this->has_camera_;
+      this->position_ = this->camera_;
+    } else {
+      if (_now >= this->next_lookup_ || _now + 1.0 < this->next_lookup_) {
+        this->entity_ = this->world_->EntityByName(this->name_);
+        this->next_lookup_ = _now + 1.0;
+      }
+      this->valid_ = static_cast<bool>(this->entity_);
+      if (this->valid_) this->position_ = this->entity_->WorldPose().Pos();
+    }
+  }
+  _position = this->position_;
+  return this->valid_;
+}
+
+/////////////////////////////////////////////////
+void AnimationLodReference::OnCameraPose(ConstPosePtr &_msg) {
+  std::lock_guard<std::mutex> lock(this->camera_mutex_);
+  this->camera_ = msgs::ConvertIgn(*_msg).Pos();
+  this->has_camera_ = true;
+}
+
+/////////////////////////////////////////////////
+bool AnimationLod::Update(physics::Actor &_actor,
+                          const AnimationLodParams &_params, bool _far,
+                          double _now) {
+  // Refreshes start over when the time goes back
+  bool animate = !_far;
+  if (_far && _params.rate > 0) {
+    animate = this->refresh_ < 0 || _now < this->refresh_ ||
+              _now - this->refresh_ >= 1.0 / _params.rate;
+  }
+  if (animate) this->refresh_ = _now;
+
+  // Playing only resets the start of the SDF script, which an actor
+  // following a custom trajectory does not use
+  if (animate && this->stopped_) {
+    _actor.Play();
+    this->stopped_ = false;
+  } else if (!animate && !this->stopped_) {
+    _actor.Stop();
+    this->stopped_ = true;
+  }
+  return animate;
+}
+
+/////////////////////////////////////////////////
+void AnimationLod::Resume(physics::Actor &_actor) {
+  if (!this->stopped_) return;
+  _actor.Play();
+  this->stopped_ = false;
+}
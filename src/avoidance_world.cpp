@@ -0,0 +1,61 @@
+#include <gazebo_ros_actor_plugin/avoidance_world.h>
+
+#include <cmath>
+
+using namespace gazebo;
+
+namespace {
+/// \brief Height band of an actor, obstacles entirely below or above it
+/// are ignored.
+constexpr double kMinObstacleZ = 0.1;
+constexpr double kMaxObstacleZ = 1.8;
+}  // namespace
+
+/////////////////////////////////////////////////
+void gazebo::LoadAvoidanceParams(const sdf::ElementPtr &_sdf,
+                                 AvoidanceParams &_params) {
+  if (_sdf->HasElement("avoidance_radius")) {
+    _params.radius = _sdf->Get<double>("avoidance_radius");
+  }
+  if (_sdf->HasElement("avoidance_range")) {
+    _params.range = _sdf->Get<double>("avoidance_range");
+  }
+  if (_sdf->HasElement("avoidance_strength")) {
+    _params.strength = _sdf->Get<double>("avoidance_strength");
+  }
+  if (_sdf->HasElement("avoidance_falloff")) {
+    _params.falloff = _sdf->Get<double>("avoidance_falloff");
+  }
+  if (_sdf->HasElement("avoidance_obstacle_strength")) {
+    _params.obstacle_strength =
+        _sdf->Get<double>("avoidance_obstacle_strength");
+  }
+  if (_sdf->HasElement("avoidance_resolution")) {
+    _params.resolution = _sdf->Get<double>("avoidance_resolution");
+  }
+}
+
+/////////////////////////////////////////////////
+std::vector<ObstacleFootprint> gazebo::StaticObstacleFootprints(
+    const physics::WorldPtr &_world) {
+  std::vector<ObstacleFootprint> footprints;
+  for (const physics::ModelPtr &model : _world->Models()) {
+    if (!model->IsStatic() ||
+        boost::dynamic_pointer_cast<physics::Actor>(model)) {
+      continue;
+    }
+    for (const physics::LinkPtr &link : model->GetLinks()) {
+      const auto box = link->BoundingBox();
+      // Links without collisions have an empty box
+      if (!std::isfinite(box.Min().X()) || !std::isfinite(box.Max().X()) ||
+          box.Min().X() > box.Max().X() || box.Min().Y() > box.Max().Y()) {
+        continue;
+      }
+      if (box.Max().Z() < kMinObstacleZ || box.Min().Z() > kMaxObstacleZ)
+        continue;
+      footprints.push_back(ObstacleFootprint{box.Min().X(), box.Min().Y(),
+                                             box.Max().X(), box.Max().Y()});
+    }
+  }
+  return footprints;
+}
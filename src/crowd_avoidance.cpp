@@ -0,0 +1,317 @@
+#include <gazebo_ros_actor_plugin/crowd_avoidance.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+using namespace gazebo;
+
+namespace {
+/// \brief Maximum number of cells of the obstacle map, the resolution is
+/// coarsened to stay below it.
+constexpr size_t kMaxObstacleCells = 1 << 22;
+
+/// \brief Position of free slots, out of reach of every actor.
+constexpr double kFreeSlot = 1e15;
+
+/// \brief Weight of the repulsion of actors behind, relative to the ones
+/// ahead.
+constexpr double kBehindWeight = 0.5;
+
+/// \brief Fraction of the repulsion turned into a push to the right.
+constexpr double kSideBias = 0.3;
+
+/// \brief Number of actors whose velocity a thread corrects at once.
+constexpr size_t kCorrectGrain = 64;
+}  // namespace
+
+/////////////////////////////////////////////////
+void ObstacleMap::Build(const std::vector<ObstacleFootprint> &_boxes,
+                        double _resolution, double _margin) {
+  this->nearest_.clear();
+  this->nx_ = this->ny_ = 0;
+  if (_boxes.empty()) return;
+
+  double min_x = _boxes[0].min_x;
+  double min_y = _boxes[0].min_y;
+  double max_x = _boxes[0].max_x;
+  double max_y = _boxes[0].max_y;
+  for (const ObstacleFootprint &box : _boxes) {
+    min_x = std::min(min_x, box.min_x);
+    min_y = std::min(min_y, box.min_y);
+    max_x = std::max(max_x, box.max_x);
+    max_y = std::max(max_y, box.max_y);
+  }
+  this->min_x_ = min_x - _margin;
+  this->min_y_ = min_y - _margin;
+  const double width = max_x - min_x + 2 * _margin;
+  const double height = max_y - min_y + 2 * _margin;
+
+  double res = std::max(_resolution, 1e-3);
+  while ((width / res + 1) * (height / res + 1) > kMaxObstacleCells) res *= 2;
+  this->resolution_ = res;
+  this->nx_ = static_cast<int>(width / res) + 1;
+  this->ny_ = static_cast<int>(height / res) + 1;
+  const int nx = this->nx_;
+  const int ny = this->ny_;
+  this->nearest_.assign(static_cast<size_t>(nx) * ny, -1);
+
+  // Occupied cells are their own nearest obstacle
+  for (const ObstacleFootprint &box : _boxes) {
+    const int x0 = static_cast<int>((box.min_x - this->min_x_) / res);
+    const int x1 = static_cast<int>((box.max_x - this->min_x_) / res);
+    const int y0 = static_cast<int>((box.min_y - this->min_y_) / res);
+    const int y1 = static_cast<int>((box.max_y - this->min_y_) / res);
+    for (int y = std::max(y0, 0); y <= std::min(y1, ny - 1); ++y) {
+      for (int x = std::max(x0, 0); x <= std::min(x1, nx - 1); ++x)
+        this->nearest_[y * nx + x] = y * nx + x;
+    }
+  }
+
+  // Propagate the nearest obstacle to every cell, with one forward and one
+  // backward sweep over the 8-neighborhood
+  auto relax = [&](int _x, int _y, int _nx, int _ny) {
+    if (_nx < 0 || _nx >= nx || _ny < 0 || _ny >= ny) return;
+    const int32_t candidate = this->nearest_[_ny * nx + _nx];
+    if (candidate < 0) return;
+    int32_t &current = this->nearest_[_y * nx + _x];
+    auto dist2 = [&](int32_t _c) {
+      const int dx = _c % nx - _x;
+      const int dy = _c / nx - _y;
+      return dx * dx + dy * dy;
+    };
+    if (current < 0 || dist2(candidate) < dist2(current)) current = candidate;
+  };
+  for (int y = 0; y < ny; ++y) {
+    for (int x = 0; x < nx; ++x) {
+      relax(x, y, x - 1, y);
+      relax(x, y, x - 1, y - 1);
+      relax(x, y, x, y - 1);
+      relax(x, y, x + 1, y - 1);
+    }
+    for (int x = nx - 1; x >= 0; --x) relax(x, y, x + 1, y);
+  }
+  for (int y = ny - 1; y >= 0; --y) {
+    for (int x = nx - 1; x >= 0; --x) {
+      relax(x, y, x + 1, y);
+      relax(x, y, x + 1, y + 1);
+      relax(x, y, x, y + 1);
+      relax(x, y, x - 1, y + 1);
+    }
+    for (int x = 0; x < nx; ++x) relax(x, y, x - 1, y);
+  }
+}
+
+/////////////////////////////////////////////////
+bool ObstacleMap::Nearest(double _x, double _y, double &_dx, double &_dy,
+                          double &_dist) const {
+  if (this->nearest_.empty()) return false;
+  const double fx = (_x - this->min_x_) / this->resolution_;
+  const double fy = (_y - this->min_y_) / this->resolution_;
+  if (fx < 0 || fy < 0 || fx >= this->nx_ || fy >= this->ny_) return false;
+
+  const int32_t nearest =
+      this->nearest_[static_cast<int>(fy) * this->nx_ + static_cast<int>(fx)];
+  if (nearest < 0) return false;
+
+  // Distance to the border of the occupied cell; inside an obstacle there
+  // is no way out to push towards
+  const double ox = this->min_x_ + (nearest % this->nx_ + 0.5) *
+                                       this->resolution_;
+  const double oy = this->min_y_ + (nearest / this->nx_ + 0.5) *
+                                       this->resolution_;
+  const double d = std::hypot(_x - ox, _y - oy);
+  if (d <= 0) return false;
+  _dx = (_x - ox) / d;
+  _dy = (_y - oy) / d;
+  _dist = std::max(d - 0.5 * this->resolution_, 0.0);
+  return true;
+}
+
+/////////////////////////////////////////////////
+void SpatialHash::Build(const double *_x, const double *_y, size_t _n,
+                        double _cell) {
+  this->cell_ = _cell;
+  size_t buckets = 1;
+  while (buckets < 2 * _n) buckets <<= 1;
+  this->mask_ = buckets - 1;
+
+  // Counting sort of the positions by bucket
+  this->start_.assign(buckets + 1, 0);
+  this->keys_.resize(_n);
+  for (size_t i = 0; i < _n; ++i) {
+    this->keys_[i] = this->Bucket(this->Cell(_x[i]), this->Cell(_y[i]));
+    ++this->start_[this->keys_[i] + 1];
+  }
+  for (size_t b = 0; b < buckets; ++b) this->start_[b + 1] += this->start_[b];
+
+  this->items_.resize(_n);
+  for (size_t i = _n; i-- > 0;)
+    this->items_[--this->start_[this->keys_[i] + 1]] = i;
+  // Each bucket start was moved back to the end of the previous bucket,
+  // shift them back in place
+  for (size_t b = 0; b < buckets; ++b) this->start_[b] = this->start_[b + 1];
+  this->start_[buckets] = _n;
+}
+
+/////////////////////////////////////////////////
+size_t SpatialHash::Bucket(int64_t _cx, int64_t _cy) const {
+  const uint64_t h = static_cast<uint64_t>(_cx) * 73856093u ^
+                     static_cast<uint64_t>(_cy) * 19349663u;
+  return h & this->mask_;
+}
+
+/////////////////////////////////////////////////
+int64_t SpatialHash::Cell(double _v) const {
+  return static_cast<int64_t>(std::floor(_v / this->cell_));
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<CrowdAvoidance> CrowdAvoidance::Acquire(
+    const AvoidanceParams &_params) {
+  static std::mutex mutex;
+  static std::weak_ptr<CrowdAvoidance> instance;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<CrowdAvoidance> avoidance = instance.lock();
+  if (!avoidance) {
+    avoidance = std::make_shared<CrowdAvoidance>();
+    avoidance->Configure(_params);
+    instance = avoidance;
+  }
+  return avoidance;
+}
+
+/////////////////////////////////////////////////
+void CrowdAvoidance::BuildObstacles(
+    const std::vector<ObstacleFootprint> &_boxes) {
+  this->obstacles_.Build(_boxes, this->params_.resolution,
+                         this->params_.range);
+  this->obstacles_built_ = true;
+}
+
+/////////////////////////////////////////////////
+void CrowdAvoidance::Apply(ActorStateStore &_store, double _dt,
+                           ActorWorkerPool *_pool) {
+  const size_t n = _store.Size();
+  this->hash_.Build(_store.x.data(), _store.y.data(), n, this->params_.range);
+
+  // Corrections are computed from the positions of the kernel, then
+  // applied to every actor at once
+  this->corrected_x_.assign(_store.vel_x.begin(), _store.vel_x.end());
+  this->corrected_y_.assign(_store.vel_y.begin(), _store.vel_y.end());
+  auto correct = [&](size_t _begin, size_t _end) {
+    for (size_t i = _begin; i < _end; ++i) {
+      this->Correct(i, _store.x.data(), _store.y.data(), _store.x[i],
+                    _store.y[i], this->corrected_x_[i],
+                    this->corrected_y_[i]);
+    }
+  };
+  if (_pool) {
+    _pool->ParallelFor(n, kCorrectGrain, correct);
+  } else {
+    correct(0, n);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    _store.x[i] += (this->corrected_x_[i] - _store.vel_x[i]) * _dt;
+    _store.y[i] += (this->corrected_y_[i] - _store.vel_y[i]) * _dt;
+    _store.vel_x[i] = this->corrected_x_[i];
+    _store.vel_y[i] = this->corrected_y_[i];
+    _store.travelled[i] =
+        std::hypot(this->corrected_x_[i], this->corrected_y_[i]) * _dt;
+  }
+}
+
+/////////////////////////////////////////////////
+size_t CrowdAvoidance::Register(double _x, double _y) {
+  // The others see the actor where it stands, not at the origin
+  for (size_t i = 0; i < this->slot_x_.size(); ++i) {
+    if (this->slot_x_[i] == kFreeSlot) {
+      this->slot_x_[i] = _x;
+      this->slot_y_[i] = _y;
+      return i;
+    }
+  }
+  this->slot_x_.push_back(_x);
+  this->slot_y_.push_back(_y);
+  return this->slot_x_.size() - 1;
+}
+
+/////////////////////////////////////////////////
+void CrowdAvoidance::Unregister(size_t _slot) {
+  this->slot_x_[_slot] = this->slot_y_[_slot] = kFreeSlot;
+}
+
+/////////////////////////////////////////////////
+void CrowdAvoidance::Avoid(size_t _slot, double _time, double _x, double _y,
+                           double &_vx, double &_vy) {
+  // The first actor of an update takes a snapshot of every position
+  if (_time != this->hash_time_) {
+    this->hashed_x_ = this->slot_x_;
+    this->hashed_y_ = this->slot_y_;
+    this->hash_.Build(this->hashed_x_.data(), this->hashed_y_.data(),
+                      this->hashed_x_.size(), this->params_.range);
+    this->hash_time_ = _time;
+  }
+
+  this->Correct(_slot, this->hashed_x_.data(), this->hashed_y_.data(), _x, _y,
+                _vx, _vy);
+  this->slot_x_[_slot] = _x;
+  this->slot_y_[_slot] = _y;
+}
+
+/////////////////////////////////////////////////
+void CrowdAvoidance::Correct(size_t _self, const double *_x, const double *_y,
+                             double _px, double _py, double &_vx,
+                             double &_vy) const {
+  const double speed = std::hypot(_vx, _vy);
+  if (speed <= 0) return;
+  const double ux = _vx / speed;
+  const double uy = _vy / speed;
+  const AvoidanceParams &p = this->params_;
+  const double range2 = p.range * p.range;
+
+  double fx = 0;
+  double fy = 0;
+  this->hash_.ForEachNear(_px, _py, [&](size_t _j) {
+    if (_j == _self) return;
+    const double dx = _px - _x[_j];
+    const double dy = _py - _y[_j];
+    const double d2 = dx * dx + dy * dy;
+    if (d2 >= range2 || d2 <= 0) return;
+    const double d = std::sqrt(d2);
+    const double nx = dx / d;
+    const double ny = dy / d;
+    // Actors ahead matter more than the ones behind
+    const double ahead = -(nx * ux + ny * uy);
+    const double weight =
+        kBehindWeight + (1 - kBehindWeight) * 0.5 * (1 + ahead);
+    const double mag = weight * p.strength * std::exp((2 * p.radius - d) /
+                                                      p.falloff);
+    fx += mag * nx;
+    fy += mag * ny;
+  });
+
+  double ox, oy, dist;
+  if (this->obstacles_.Nearest(_px, _py, ox, oy, dist) && dist < p.range) {
+    const double mag =
+        p.obstacle_strength * std::exp((p.radius - dist) / p.falloff);
+    fx += mag * ox;
+    fy += mag * oy;
+  }
+
+  // Keep to the right of the desired direction when pushed back
+  const double f = std::hypot(fx, fy);
+  fx += kSideBias * f * uy;
+  fy -= kSideBias * f * ux;
+
+  // Never faster than desired
+  _vx += fx;
+  _vy += fy;
+  const double corrected = std::hypot(_vx, _vy);
+  if (corrected > speed) {
+    _vx *= speed / corrected;
+    _vy *= speed / corrected;
+  }
+}
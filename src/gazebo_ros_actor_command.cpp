@@ -1,39 +1,63 @@
 #include <gazebo_ros_actor_plugin/gazebo_ros_actor_command.h>
-#include <tf2/LinearMath/Matrix3x3.h>
-#include <tf2/LinearMath/Quaternion.h>
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 
 #include <ignition/math.hh>
 #include "gazebo/physics/physics.hh"
+#include "gazebo_ros_actor_plugin/avoidance_world.h"
 
 using namespace gazebo;
 
 #define _USE_MATH_DEFINES
-#define WALKING_ANIMATION "walking"
-#define STANDING_ANIMATION "standing"
 #define ROTATION "rotate"
 
 /////////////////////////////////////////////////
-GazeboRosActorCommand::GazeboRosActorCommand() {}
+GazeboRosActorCommand::GazeboRosActorCommand()
+    : ros_node_(nullptr),
+      ros_ready_(false),
+      animation_(ANIMATION_STANDING),
+      reset_requested_(false),
+      reset_teleport_(false),
+      avoidance_slot_(0) {}
 
 GazeboRosActorCommand::~GazeboRosActorCommand() {
+  // A pending registration must not create what is torn down below
+  if (this->registrar_) this->registrar_->Cancel(this);
+
+  // Drop our callbacks from the queues before they go away
+  this->vel_sub_.shutdown();
+  this->path_sub_.shutdown();
+  this->path_update_sub_.shutdown();
+  this->abort_sub_.shutdown();
+  this->mode_sub_.shutdown();
+  this->mode_srv_.shutdown();
+  this->reset_srv_.shutdown();
+  if (this->command_router_) this->command_router_->Unregister(this->name_);
+  this->shared_queue_.reset();
+  if (this->avoidance_) this->avoidance_->Unregister(this->avoidance_slot_);
+
   this->vel_queue_.clear();
   this->vel_queue_.disable();
-  this->velCallbackQueueThread_.join();
+  if (this->velCallbackQueueThread_.joinable())
+    this->velCallbackQueueThread_.join();
 
   // Added for path
   this->path_queue_.clear();
   this->path_queue_.disable();
-  this->pathCallbackQueueThread_.join();
+  if (this->pathCallbackQueueThread_.joinable())
+    this->pathCallbackQueueThread_.join();
 
   this->abort_queue_.clear();
   this->abort_queue_.disable();
-  this->abortCallbackQueueThread_.join();
+  if (this->abortCallbackQueueThread_.joinable())
+    this->abortCallbackQueueThread_.join();
 
-  this->ros_node_->shutdown();
-  delete this->ros_node_;
+  if (this->ros_node_) {
+    this->ros_node_->shutdown();
+    delete this->ros_node_;
+  }
 }
 
 /////////////////////////////////////////////////
@@ -43,13 +67,37 @@ void GazeboRosActorCommand::Load(physics::ModelPtr _model,
   this->follow_mode_ = "velocity";
   this->vel_topic_ = "/cmd_vel";
   this->path_topic_ = "/cmd_path";
+  this->path_update_topic_ = "/cmd_path_update";
+  this->path_resume_ = "start";
   this->abort_topic_ = "/abort_goal";
+  this->mode_topic_ = "/cmd_mode";
+  this->command_topic_ = "/actor_commands";
+  this->mode_service_ = "";
+  this->reset_service_ = "";
   this->lin_tolerance_ = 0.1;
+  this->lookahead_ = 0;
   this->lin_velocity_ = 1;
   this->ang_tolerance_ = IGN_DTOR(5);
   this->ang_velocity_ = IGN_DTOR(10);
   this->animation_factor_ = 4.0;
-  this->abort_ = false;
+  this->default_rotation_ = 1.57;
+  this->callback_threads_ = 1;
+  this->registration_threads_ = 4;
+  this->command_policy_ = "fifo";
+  this->command_queue_size_ = VelocityCommandBuffer::kMaxQueueSize;
+  this->command_timeout_ = 0;
+  this->command_arbitration_ = "none";
+  this->preempt_timeout_ = 1.0;
+  this->lockstep_ = false;
+  ACTOR_DIAG(this->diagnostics_rate_ = 1.0;)
+  this->odom_rate_ = 0;
+  this->odom_lazy_ = true;
+  this->idle_odom_rate_ = 1.0;
+  this->odom_frame_ = "map";
+  this->base_frame_ = "base_link";
+  this->publish_tf_ = false;
+  this->tf_rate_ = 0;
+  double control_rate = 0;
 
   // Override default parameter values with values from SDF
   if (_sdf->HasElement("follow_mode")) {
@@ -61,12 +109,33 @@ void GazeboRosActorCommand::Load(physics::ModelPtr _model,
   if (_sdf->HasElement("path_topic")) {
     this->path_topic_ = _sdf->Get<std::string>("path_topic");
   }
+  if (_sdf->HasElement("path_update_topic")) {
+    this->path_update_topic_ = _sdf->Get<std::string>("path_update_topic");
+  }
+  if (_sdf->HasElement("path_resume")) {
+    this->path_resume_ = _sdf->Get<std::string>("path_resume");
+  }
   if (_sdf->HasElement("abort_topic")) {
     this->abort_topic_ = _sdf->Get<std::string>("abort_topic");
   }
+  if (_sdf->HasElement("mode_topic")) {
+    this->mode_topic_ = _sdf->Get<std::string>("mode_topic");
+  }
+  if (_sdf->HasElement("command_topic")) {
+    this->command_topic_ = _sdf->Get<std::string>("command_topic");
+  }
+  if (_sdf->HasElement("mode_service")) {
+    this->mode_service_ = _sdf->Get<std::string>("mode_service");
+  }
+  if (_sdf->HasElement("reset_service")) {
+    this->reset_service_ = _sdf->Get<std::string>("reset_service");
+  }
   if (_sdf->HasElement("linear_tolerance")) {
     this->lin_tolerance_ = _sdf->Get<double>("linear_tolerance");
   }
+  if (_sdf->HasElement("lookahead_distance")) {
+    this->lookahead_ = _sdf->Get<double>("lookahead_distance");
+  }
   if (_sdf->HasElement("linear_velocity")) {
     this->lin_velocity_ = _sdf->Get<double>("linear_velocity");
   }
@@ -82,6 +151,122 @@ void GazeboRosActorCommand::Load(physics::ModelPtr _model,
   if (_sdf->HasElement("default_rotation")) {
     this->default_rotation_ = _sdf->Get<double>("default_rotation");
   }
+  if (_sdf->HasElement("callback_threads")) {
+    this->callback_threads_ = _sdf->Get<int>("callback_threads");
+  }
+  if (_sdf->HasElement("registration_threads")) {
+    this->registration_threads_ = _sdf->Get<int>("registration_threads");
+  }
+  if (_sdf->HasElement("command_policy")) {
+    this->command_policy_ = _sdf->Get<std::string>("command_policy");
+  }
+  if (_sdf->HasElement("command_queue_size")) {
+    this->command_queue_size_ = _sdf->Get<int>("command_queue_size");
+  }
+  if (_sdf->HasElement("command_timeout")) {
+    this->command_timeout_ = _sdf->Get<double>("command_timeout");
+  }
+  if (_sdf->HasElement("command_arbitration")) {
+    this->command_arbitration_ =
+        _sdf->Get<std::string>("command_arbitration");
+  }
+  if (_sdf->HasElement("preempt_timeout")) {
+    this->preempt_timeout_ = _sdf->Get<double>("preempt_timeout");
+  }
+  if (_sdf->HasElement("lockstep")) {
+    this->lockstep_ = _sdf->Get<bool>("lockstep");
+  }
+#ifdef ACTOR_DIAGNOSTICS
+  if (_sdf->HasElement("diagnostics_rate")) {
+    this->diagnostics_rate_ = _sdf->Get<double>("diagnostics_rate");
+  }
+#endif
+  if (_sdf->HasElement("odom_rate")) {
+    this->odom_rate_ = _sdf->Get<double>("odom_rate");
+  }
+  if (_sdf->HasElement("idle_odom_rate")) {
+    this->idle_odom_rate_ = _sdf->Get<double>("idle_odom_rate");
+  }
+  if (_sdf->HasElement("odom_only_when_subscribed")) {
+    this->odom_lazy_ = _sdf->Get<bool>("odom_only_when_subscribed");
+  }
+  if (_sdf->HasElement("odom_frame")) {
+    this->odom_frame_ = _sdf->Get<std::string>("odom_frame");
+  }
+  if (_sdf->HasElement("base_frame")) {
+    this->base_frame_ = _sdf->Get<std::string>("base_frame");
+  }
+  if (_sdf->HasElement("publish_tf")) {
+    this->publish_tf_ = _sdf->Get<bool>("publish_tf");
+  }
+  if (_sdf->HasElement("tf_rate")) {
+    this->tf_rate_ = _sdf->Get<double>("tf_rate");
+  }
+  if (_sdf->HasElement("control_rate")) {
+    control_rate = _sdf->Get<double>("control_rate");
+  }
+  this->control_clock_.Configure(control_rate);
+  bool avoidance = false;
+  if (_sdf->HasElement("avoidance")) {
+    avoidance = _sdf->Get<bool>("avoidance");
+  }
+  AvoidanceParams avoidance_params;
+  LoadAvoidanceParams(_sdf, avoidance_params);
+  AnimationNames animation_names;
+  LoadAnimationNames(_sdf, animation_names);
+  LoadAnimationLodParams(_sdf, this->lod_params_);
+  LoadPredictionParams(_sdf, this->prediction_params_);
+  RecordingParams recording_params;
+  LoadRecordingParams(_sdf, recording_params);
+
+  ArbiterParams arbiter_params;
+  if (!ParseActorMode(this->follow_mode_, arbiter_params.initial_mode)) {
+    gzerr << "Unknown follow mode " << this->follow_mode_
+          << ", using idle.\n";
+    arbiter_params.initial_mode = ACTOR_MODE_IDLE;
+  }
+
+  // Motion parameters of the path and velocity controllers
+  this->kernel_params_.lin_velocity = this->lin_velocity_;
+  this->kernel_params_.ang_velocity = this->ang_velocity_;
+  this->kernel_params_.ang_tolerance = this->ang_tolerance_;
+  this->kernel_params_.default_rotation = this->default_rotation_;
+  this->orientation_ = ActorOrientation(this->default_rotation_);
+
+  CommandPolicy policy = CommandPolicy::FIFO;
+  if (!ParseCommandPolicy(this->command_policy_, policy)) {
+    gzerr << "Unknown command policy " << this->command_policy_
+          << ", using fifo.\n";
+  }
+  if (this->lockstep_ && policy != CommandPolicy::STAMPED) {
+    // Commands wait for the simulation time they are stamped with
+    gzmsg << "Lockstep mode uses the stamped command policy.\n";
+    policy = CommandPolicy::STAMPED;
+  }
+  if (policy == CommandPolicy::STAMPED && !ros::Time::isSimTime()) {
+    // Stamps would be wall times, far ahead of the simulation time
+    gzerr << "The stamped command policy compares command stamps with the "
+          << "simulation time, but use_sim_time is not set. Commands stamped "
+          << "with the wall time are never applied.\n";
+  }
+  arbiter_params.policy = policy;
+  arbiter_params.queue_size = std::max(this->command_queue_size_, 1);
+  arbiter_params.command_timeout = this->command_timeout_;
+  if (!ParseCommandArbitration(this->command_arbitration_,
+                               arbiter_params.arbitration)) {
+    gzerr << "Unknown command arbitration " << this->command_arbitration_
+          << ", using none.\n";
+    arbiter_params.arbitration = CommandArbitration::NONE;
+  }
+  arbiter_params.preempt_timeout = this->preempt_timeout_;
+  if (!ParsePathResume(this->path_resume_, arbiter_params.path_resume)) {
+    gzerr << "Unknown path resume mode " << this->path_resume_
+          << ", using start.\n";
+    arbiter_params.path_resume = ActorPath::RESUME_START;
+  }
+  arbiter_params.lockstep = this->lockstep_;
+  arbiter_params.lookahead = this->lookahead_;
+  arbiter_params.lin_tolerance = this->lin_tolerance_;
 
   // Check if ROS node for Gazebo has been initialized
   if (!ros::isInitialized()) {
@@ -99,240 +284,752 @@ void GazeboRosActorCommand::Load(physics::ModelPtr _model,
   this->actor_ = boost::dynamic_pointer_cast<physics::Actor>(_model);
   this->world_ = this->actor_->GetWorld();
   this->name_ = this->actor_->GetName();
+  if (this->mode_service_.empty())
+    this->mode_service_ = this->name_ + "/set_mode";
+  if (this->reset_service_.empty())
+    this->reset_service_ = this->name_ + "/reset";
+  this->base_frame_ = this->base_frame_.empty()
+                          ? this->name_
+                          : this->name_ + "/" + this->base_frame_;
+  this->arbiter_.Configure(this->name_, arbiter_params);
+  ACTOR_DIAG(this->arbiter_.SetDiagnostics(&this->diagnostics_);)
+  if (avoidance) {
+    // Every actor of the world registers with the same avoidance, so they
+    // see each other
+    this->avoidance_ = CrowdAvoidance::Acquire(avoidance_params);
+    const ignition::math::Vector3d position = this->actor_->WorldPose().Pos();
+    this->avoidance_slot_ =
+        this->avoidance_->Register(position.X(), position.Y());
+  }
+  if (this->lod_params_.distance > 0) {
+    this->lod_reference_ = AnimationLodReference::Acquire(
+        this->world_, this->lod_params_.reference);
+  }
+  // Every actor recording to or replaying from the same file shares it
+  if (!recording_params.replay_file.empty()) {
+    this->replay_ = TrajectoryRecording::Acquire(recording_params.replay_file);
+    if (this->replay_) this->replay_track_ = this->replay_->Track(this->name_);
+    if (this->replay_track_.Empty()) {
+      gzerr << "No recorded trajectory of actor " << this->name_ << " in "
+            << recording_params.replay_file << ", it stands in replay mode.\n";
+    }
+  } else if (arbiter_params.initial_mode == ACTOR_MODE_REPLAY) {
+    gzerr << "Replay mode without replay_file, actor " << this->name_
+          << " stands.\n";
+  }
+  if (!recording_params.record_file.empty()) {
+    this->recorder_ = TrajectoryRecorder::Acquire(
+        recording_params.record_file, recording_params.record_rate);
+    this->record_track_ = this->recorder_->Register(this->name_);
+  }
+
+  // Check if the animations exist in the actor's skeleton animations. They
+  // are looked up once, resets reuse the trajectories.
+  this->trajectories_.Resolve(this->actor_, animation_names);
   this->Reset();
+
+  // Each topic and service costs a round trip to the master. They are
+  // registered by threads shared by all actors, so the world steps
+  // meanwhile and the round trips of the actors overlap.
+  if (this->registration_threads_ > 0) {
+    this->registrar_ = ActorRosRegistrar::Acquire(this->registration_threads_);
+    this->registrar_->Add(
+        this, std::bind(&GazeboRosActorCommand::RegisterRos, this));
+  } else {
+    this->RegisterRos();
+  }
+
+  // Connect the OnUpdate function to the WorldUpdateBegin event.
+  this->connections_.push_back(event::Events::ConnectWorldUpdateBegin(std::bind(
+      &GazeboRosActorCommand::OnUpdate, this, std::placeholders::_1)));
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::RegisterRos() {
   // Create ROS node handle
   this->ros_node_ = new ros::NodeHandle();
 
-  // Subscribe to the velocity commands
-  ros::SubscribeOptions vel_so =
-      ros::SubscribeOptions::create<geometry_msgs::Twist>(
-          vel_topic_, 1,
-          boost::bind(&GazeboRosActorCommand::VelCallback, this, _1),
-          ros::VoidPtr(), &vel_queue_);
-  this->vel_sub_ = ros_node_->subscribe(vel_so);
+  // Either serve all subscriptions from the spinner shared by all actors,
+  // or give each of them its own queue and polling thread
+  ros::CallbackQueue *vel_queue = &this->vel_queue_;
+  ros::CallbackQueue *path_queue = &this->path_queue_;
+  ros::CallbackQueue *abort_queue = &this->abort_queue_;
+  if (this->callback_threads_ > 0) {
+    this->shared_queue_ = SharedCallbackQueue::Acquire(this->callback_threads_);
+    vel_queue = path_queue = abort_queue = this->shared_queue_->Queue();
+  }
 
-  // Create a thread for the velocity callback queue
-  this->velCallbackQueueThread_ =
-      boost::thread(boost::bind(&GazeboRosActorCommand::VelQueueThread, this));
+  // Subscribe to the velocity commands, stamped ones in lockstep mode.
+  // Every command is buffered, the update thread decides which to apply.
+  ros::SubscribeOptions vel_so;
+  if (this->lockstep_) {
+    vel_so = ros::SubscribeOptions::create<geometry_msgs::TwistStamped>(
+        vel_topic_, 100,
+        boost::bind(&GazeboRosActorCommand::VelStampedCallback, this, _1),
+        ros::VoidPtr(), vel_queue);
+  } else {
+    vel_so = ros::SubscribeOptions::create<geometry_msgs::Twist>(
+        vel_topic_, 1,
+        boost::bind(&GazeboRosActorCommand::VelCallback, this, _1),
+        ros::VoidPtr(), vel_queue);
+  }
+  this->vel_sub_ = ros_node_->subscribe(vel_so);
 
   // Subscribe to the path commands
   ros::SubscribeOptions path_so = ros::SubscribeOptions::create<nav_msgs::Path>(
       path_topic_, 1,
       boost::bind(&GazeboRosActorCommand::PathCallback, this, _1),
-      ros::VoidPtr(), &path_queue_);
+      ros::VoidPtr(), path_queue);
   this->path_sub_ = ros_node_->subscribe(path_so);
 
+  // Subscribe to the incremental path updates. They share the queue of
+  // the path commands, as both build on the latest path.
+  ros::SubscribeOptions path_update_so =
+      ros::SubscribeOptions::create<gazebo_ros_actor_plugin::PathUpdate>(
+          path_update_topic_, 10,
+          boost::bind(&GazeboRosActorCommand::PathUpdateCallback, this, _1),
+          ros::VoidPtr(), path_queue);
+  this->path_update_sub_ = ros_node_->subscribe(path_update_so);
+
   // Subscribe to the abort commands
   ros::SubscribeOptions abort_so =
       ros::SubscribeOptions::create<std_msgs::Bool>(
           abort_topic_, 1,
           boost::bind(&GazeboRosActorCommand::AbortCallback, this, _1),
-          ros::VoidPtr(), &abort_queue_);
+          ros::VoidPtr(), abort_queue);
   this->abort_sub_ = ros_node_->subscribe(abort_so);
 
+  // Subscribe to the mode switches
+  ros::SubscribeOptions mode_so =
+      ros::SubscribeOptions::create<std_msgs::String>(
+          mode_topic_, 1,
+          boost::bind(&GazeboRosActorCommand::ModeCallback, this, _1),
+          ros::VoidPtr(), abort_queue);
+  this->mode_sub_ = ros_node_->subscribe(mode_so);
+
+  // Advertise the mode switching service, served like the mode topic
+  ros::AdvertiseServiceOptions mode_ao =
+      ros::AdvertiseServiceOptions::create<gazebo_ros_actor_plugin::SetMode>(
+          mode_service_,
+          boost::bind(&GazeboRosActorCommand::SetModeCallback, this, _1, _2),
+          ros::VoidPtr(), abort_queue);
+  this->mode_srv_ = ros_node_->advertiseService(mode_ao);
+
+  // Advertise the reset service
+  ros::AdvertiseServiceOptions reset_ao = ros::AdvertiseServiceOptions::create<
+      gazebo_ros_actor_plugin::ResetActors>(
+      reset_service_,
+      boost::bind(&GazeboRosActorCommand::ResetCallback, this, _1, _2),
+      ros::VoidPtr(), abort_queue);
+  this->reset_srv_ = ros_node_->advertiseService(reset_ao);
+
+  // Commands batched for many actors arrive on a single subscription
+  // shared by every actor plugin of the process
+  if (!this->command_topic_.empty()) {
+    this->command_router_ = ActorCommandRouter::Acquire(this->command_topic_);
+    this->command_router_->Register(
+        this->name_,
+        std::bind(&GazeboRosActorCommand::BatchedCommandCallback, this,
+                  std::placeholders::_1, std::placeholders::_2));
+  }
+
   this->actor_pub_ =
       ros_node_->advertise<nav_msgs::Odometry>(this->name_ + "/odom", 10);
+  ACTOR_DIAG(this->diagnostics_pub_ =
+                 ros_node_->advertise<diagnostic_msgs::DiagnosticArray>(
+                     "/diagnostics", 10);)
 
-  // Create a thread for the path callback queue
-  this->pathCallbackQueueThread_ =
-      boost::thread(boost::bind(&GazeboRosActorCommand::PathQueueThread, this));
+  // The prediction is only published when it changes, a late subscriber
+  // gets the latest one
+  if (this->prediction_params_.horizon > 0) {
+    this->prediction_pub_ = ros_node_->advertise<nav_msgs::Path>(
+        this->name_ + "/predicted_path", 1, true);
+  }
 
-  // Create a thread for the abort callback queue
-  this->abortCallbackQueueThread_ = boost::thread(
-      boost::bind(&GazeboRosActorCommand::AbortQueueThread, this));
+  if (!this->shared_queue_) {
+    // Create a thread for the velocity callback queue
+    this->velCallbackQueueThread_ = boost::thread(
+        boost::bind(&GazeboRosActorCommand::VelQueueThread, this));
 
-  // Connect the OnUpdate function to the WorldUpdateBegin event.
-  this->connections_.push_back(event::Events::ConnectWorldUpdateBegin(std::bind(
-      &GazeboRosActorCommand::OnUpdate, this, std::placeholders::_1)));
+    // Create a thread for the path callback queue
+    this->pathCallbackQueueThread_ = boost::thread(
+        boost::bind(&GazeboRosActorCommand::PathQueueThread, this));
+
+    // Create a thread for the abort callback queue
+    this->abortCallbackQueueThread_ = boost::thread(
+        boost::bind(&GazeboRosActorCommand::AbortQueueThread, this));
+  }
+
+  // Every actor plugin of the process adds its frame to the same message.
+  // The first one advertises /tf.
+  if (this->publish_tf_)
+    this->tf_broadcaster_ = ActorTfBroadcaster::Acquire(this->tf_rate_);
+
+  // Publishers are only used by the update thread from now on
+  this->ros_ready_ = true;
 }
 
 /////////////////////////////////////////////////
 void GazeboRosActorCommand::Reset() {
-  // Reset last update time and target pose index
+  // Reset last update time
   this->last_update_ = 0;
-  this->idx_ = 0;
-  // Initialize target poses vector with the current pose
+  this->last_odom_ = 0;
+  ACTOR_DIAG(this->last_diagnostics_ = 0;)
+  nav_msgs::Odometry &odom = ReusableMessage(this->odom_msg_);
+  odom.header.frame_id = this->odom_frame_;
+  odom.child_frame_id = this->base_frame_;
+  this->ResetState();
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::ResetState() {
+  // Forget the commands from before the reset and stand at the current
+  // pose, back in the mode of the SDF
   ignition::math::Pose3d pose = this->actor_->WorldPose();
-  this->target_poses_.push_back(ignition::math::Vector3d(
-      pose.Pos().X(), pose.Pos().Y(), pose.Rot().Yaw()));
-  // Set target pose to the current pose
-  this->target_pose_ = this->target_poses_.at(this->idx_);
-
-  // Check if the walking animation exists in the actor's skeleton animations
-  auto skelAnims = this->actor_->SkeletonAnimations();
-  if (skelAnims.find(WALKING_ANIMATION) == skelAnims.end()) {
-    gzerr << "Skeleton animation " << WALKING_ANIMATION << " not found.\n";
-  } else if (skelAnims.find(STANDING_ANIMATION) == skelAnims.end()) {
-    gzerr << "Skeleton animation " << STANDING_ANIMATION << " not found.\n";
-  } else {
-    // Create custom trajectory
-    this->trajectoryInfo_.reset(new physics::TrajectoryInfo());
-    this->trajectoryInfo_->type = STANDING_ANIMATION;
-    this->trajectoryInfo_->duration = 1.0;
+  this->HoldPose(pose);
+  this->arbiter_.Reset(pose.Pos().X(), pose.Pos().Y(),
+                       this->orientation_.Yaw());
+  this->predictor_.Clear();
+
+  if (this->trajectories_.Valid()) {
+    this->animation_ = ANIMATION_STANDING;
 
     // Set the actor's trajectory to the custom trajectory
-    this->actor_->SetCustomTrajectory(this->trajectoryInfo_);
+    this->actor_->SetCustomTrajectory(
+        this->trajectories_.Get(this->animation_));
+  }
+
+  if (this->arbiter_.Mode() == ACTOR_MODE_SCRIPTED) {
+    this->animation_lod_.Resume(*this->actor_);
+    this->actor_->ResetCustomTrajectory();
+    this->scripted_pose_.Set(pose.Pos().X(), pose.Pos().Y(),
+                             this->orientation_.Yaw());
   }
 }
 
 void GazeboRosActorCommand::VelCallback(
     const geometry_msgs::Twist::ConstPtr &msg) {
-  ignition::math::Vector3d vel_cmd;
-  vel_cmd.X() = msg->linear.x;
-  vel_cmd.Z() = msg->angular.z;
-  this->cmd_queue_.push(vel_cmd);
+  // Applied at the next update, whatever the policy
+  this->PushVelocity(*msg, 0);
+}
+
+void GazeboRosActorCommand::VelStampedCallback(
+    const geometry_msgs::TwistStamped::ConstPtr &msg) {
+  // Unstamped commands apply from their arrival on
+  this->PushVelocity(msg->twist, msg->header.stamp.toSec());
+}
+
+void GazeboRosActorCommand::PushVelocity(const geometry_msgs::Twist &_twist,
+                                         double _stamp) {
+  VelocityCommand vel_cmd;
+  vel_cmd.linear = _twist.linear.x;
+  vel_cmd.angular = _twist.angular.z;
+  vel_cmd.stamp = _stamp;
+  ACTOR_DIAG(vel_cmd.received = DiagnosticsClock();)
+  if (!this->arbiter_.PushVelocity(vel_cmd)) {
+    ROS_WARN_THROTTLE_NAMED(1.0, "actor",
+                            "Velocity command queue of %s is full, "
+                            "keeping only the newest of the next commands",
+                            this->name_.c_str());
+  }
 }
 
 void GazeboRosActorCommand::PathCallback(const nav_msgs::Path::ConstPtr &msg) {
-  // Extract the poses from the Path message
-  const std::vector<geometry_msgs::PoseStamped> &poses = msg->poses;
-  this->target_poses_.clear();
-  this->idx_ = 0;
-  this->abort_ = false;
+  this->arbiter_.SetPath(msg);
+}
+
+void GazeboRosActorCommand::BatchedCommandCallback(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &_msg,
+    size_t _command) {
+  // Handled like the commands of the actor's own topics
+  const gazebo_ros_actor_plugin::ActorCommand &command =
+      _msg->commands[_command];
+  if (command.type == gazebo_ros_actor_plugin::ActorCommand::VELOCITY)
+    this->PushVelocity(command.twist, CommandStamp(_msg, this->lockstep_));
+  else if (command.type == gazebo_ros_actor_plugin::ActorCommand::PATH)
+    this->PathCallback(CommandPath(_msg, _command));
+}
+
+void GazeboRosActorCommand::PathUpdateCallback(
+    const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &msg) {
+  this->arbiter_.UpdatePath(msg);
+}
+
+void GazeboRosActorCommand::ModeCallback(
+    const std_msgs::String::ConstPtr &msg) {
+  std::string message;
+  if (!this->arbiter_.RequestMode(msg->data, message)) {
+    ROS_WARN_NAMED("actor", "%s for actor %s", message.c_str(),
+                   this->name_.c_str());
+  }
+}
 
-  // Extract the x, y, and yaw from each pose and store it as a target
-  for (size_t i = 0; i < poses.size(); ++i) {
-    const geometry_msgs::Pose &pose = poses[i].pose;
-    const double x = pose.position.x;
-    const double y = pose.position.y;
+bool GazeboRosActorCommand::SetModeCallback(
+    gazebo_ros_actor_plugin::SetMode::Request &_req,
+    gazebo_ros_actor_plugin::SetMode::Response &_res) {
+  // Applied by the next update, like the mode topic
+  _res.success = this->arbiter_.RequestMode(_req.mode, _res.message);
+  return true;
+}
+
+bool GazeboRosActorCommand::ResetCallback(
+    gazebo_ros_actor_plugin::ResetActors::Request &_req,
+    gazebo_ros_actor_plugin::ResetActors::Response &_res) {
+  if (_req.names.size() > 1 ||
+      (_req.names.size() == 1 && _req.names[0] != this->name_)) {
+    _res.success = false;
+    _res.message = "Only actor " + this->name_ + " can be reset";
+    return true;
+  }
+  if (_req.poses.size() > 1) {
+    _res.success = false;
+    _res.message = "Expected at most one pose";
+    return true;
+  }
 
-    // Convert quaternion to Euler angles
-    tf2::Quaternion quat(pose.orientation.x, pose.orientation.y,
-                         pose.orientation.z, pose.orientation.w);
-    tf2::Matrix3x3 mat(quat);
-    double roll, pitch, yaw;
-    mat.getRPY(roll, pitch, yaw);
-    this->target_poses_.push_back(ignition::math::Vector3d(x, y, yaw));
+  // Applied by the next update
+  {
+    std::lock_guard<std::mutex> lock(this->reset_mutex_);
+    this->reset_teleport_ = !_req.poses.empty();
+    if (this->reset_teleport_) {
+      this->reset_pose_.Set(_req.poses[0].x, _req.poses[0].y,
+                            _req.poses[0].theta);
+    }
   }
+  this->reset_requested_ = true;
+  _res.success = true;
+  _res.message = "Resetting actor " + this->name_;
+  return true;
 }
 
 void GazeboRosActorCommand::AbortCallback(const std_msgs::Bool::ConstPtr &msg) {
-  this->abort_ = msg->data;
+  this->arbiter_.Abort(msg->data);
 }
 
 /////////////////////////////////////////////////
 void GazeboRosActorCommand::OnUpdate(const common::UpdateInfo &_info) {
+  ACTOR_DIAG(const double update_start = DiagnosticsClock();)
+  ACTOR_DIAG(this->diagnostics_.queue_depth.Add(
+                 this->arbiter_.PendingCommands());)
+
+  // Reset the actor if requested since the last update
+  if (this->reset_requested_.exchange(false)) this->ApplyReset();
+
+  // Switch to a mode requested since the last update
+  ActorMode requested;
+  if (this->arbiter_.TakeRequestedMode(requested)) this->SwitchMode(requested);
+
   // Time delta
   double dt = (_info.simTime - this->last_update_).Double();
   ignition::math::Pose3d pose = this->actor_->WorldPose();
-  ignition::math::Vector3d rpy = pose.Rot().Euler();
 
-  nav_msgs::Odometry human_odom;
-  human_odom.header.frame_id = "map";
-  human_odom.header.stamp = ros::Time::now();
-  human_odom.pose.pose.position.x = pose.Pos().X();
-  human_odom.pose.pose.position.y = pose.Pos().Y();
-  // Set the rotation of the human in odom
-  tf2::Quaternion quaternion_tf2;
-  quaternion_tf2.setRPY(0, 0, rpy.Z() - default_rotation_);
-  geometry_msgs::Quaternion quaternion = tf2::toMsg(quaternion_tf2);
-  human_odom.pose.pose.orientation = quaternion;
-
-  if (this->follow_mode_ == "path") {
-    this->trajectoryInfo_->type = WALKING_ANIMATION;
-    ignition::math::Vector2d target_pos_2d(this->target_pose_.X(),
-                                           this->target_pose_.Y());
-    ignition::math::Vector2d current_pos_2d(pose.Pos().X(), pose.Pos().Y());
-    ignition::math::Vector2d pos = target_pos_2d - current_pos_2d;
-    double distance = pos.Length();
-
-    if (this->abort_ || this->target_poses_.empty()) {
-      this->target_poses_.clear();
-      this->idx_ = 0;
-      pos.X() = 0;
-      pos.Y() = 0;
-    }
+  // The controllers run at the control rate, each tick moving the actor to
+  // where it should be at the next one
+  const double now = _info.simTime.Double();
+  double control_dt = dt;
+  if (this->control_clock_.Tick(now, dt, control_dt)) {
+    this->Control(now, control_dt, pose);
+    this->UpdatePrediction(now);
+  }
 
-    // Check if actor has reached current target position
-    else if (distance < this->lin_tolerance_) {
-      // If there are more targets, choose new target
-      if (this->idx_ < this->target_poses_.size() - 1) {
-        this->ChooseNewTarget();
-        pos.X() = this->target_pose_.X() - pose.Pos().X();
-        pos.Y() = this->target_pose_.Y() - pose.Pos().Y();
-      } else {
-        // All targets have been accomplished, stop moving
-        pos.X() = 0;
-        pos.Y() = 0;
-        this->trajectoryInfo_->type = STANDING_ANIMATION;
-      }
-    }
+  // An actor standing still over a whole control step sleeps once its pose
+  // has been written, until a command moves it again: its pose is left as
+  // it is and its odometry is only kept alive
+  const bool still = this->arbiter_.Mode() != ACTOR_MODE_SCRIPTED &&
+                     IsStill(this->control_from_, this->control_to_);
+  const bool asleep = still && this->asleep_;
+  this->asleep_ = still;
+  if (asleep) {
+    if (this->OdomDue(_info.simTime, true))
+      this->PublishOdom(_info.simTime, this->control_to_, this->orientation_);
+    this->BroadcastTf(_info.simTime, this->control_to_, this->orientation_);
+    this->Record(now, this->control_to_);
+    this->last_update_ = _info.simTime;
+    ACTOR_DIAG(this->diagnostics_.update.Add(DiagnosticsClock() -
+                                             update_start);)
+    ACTOR_DIAG(this->PublishDiagnostics(_info.simTime);)
+    return;
+  }
 
-    // Normalize the direction vector
-    if (pos.Length() != 0) {
-      pos = pos / pos.Length();
-    }
+  // Pose of the actor at this update, part of the way through the step of
+  // the controllers
+  const ActorStep state = InterpolateStep(
+      this->control_from_, this->control_to_, this->control_clock_.Alpha(now));
+  // Only an interpolated yaw needs its own sine and cosine
+  ActorOrientation orientation = this->orientation_;
+  if (state.yaw != orientation.Yaw()) orientation.Set(state.yaw);
 
-    int rot_sign = 1;
-    // Calculate the angular displacement required based on the direction
-    // vector towards the current target position
-    ignition::math::Angle yaw(0);
-    if (pos.Length() != 0) {
-      yaw = atan2(pos.Y(), pos.X()) + default_rotation_ - rpy.Z();
-      yaw.Normalize();
-    }
+  if (this->OdomDue(_info.simTime, false))
+    this->PublishOdom(_info.simTime, state, orientation);
+  this->BroadcastTf(_info.simTime, state, orientation);
+  this->Record(now, state);
 
-    if (yaw < 0) rot_sign = -1;
-    // Check if required angular displacement is greater than tolerance
-    if (std::abs(yaw.Radian()) > this->ang_tolerance_) {
-      pose.Rot() = ignition::math::Quaterniond(
-          default_rotation_, 0, rpy.Z() + rot_sign * this->ang_velocity_ * dt);
-      human_odom.twist.twist.angular.z = rot_sign * this->ang_velocity_;
-    } else {
-      // Move towards the target position
-      pose.Pos().X() += pos.X() * this->lin_velocity_ * dt;
-      pose.Pos().Y() += pos.Y() * this->lin_velocity_ * dt;
-      human_odom.twist.twist.linear.x = pos.X() * this->lin_velocity_;
-      human_odom.twist.twist.linear.y = pos.Y() * this->lin_velocity_;
-
-      pose.Rot() = ignition::math::Quaterniond(default_rotation_, 0,
-                                               rpy.Z() + yaw.Radian());
-      human_odom.twist.twist.angular.z = yaw.Radian() / dt;
-    }
+  // Scripted actors are moved by their own trajectory
+  if (this->arbiter_.Mode() != ACTOR_MODE_SCRIPTED) {
+    // Distance traveled is used to coordinate motion with the walking
+    // animation
+    const double distanceTraveled =
+        std::hypot(state.x - pose.Pos().X(), state.y - pose.Pos().Y());
+    pose.Pos().X() = state.x;
+    pose.Pos().Y() = state.y;
+    pose.Rot() = orientation.Rotation();
+
+    // Distant actors skip skeleton refreshes, their root pose is then
+    // published on its own
+    const bool animated = this->UpdateAnimationLod(now, pose.Pos());
+    this->actor_->SetWorldPose(pose, false, !animated);
+    this->actor_->SetScriptTime(this->actor_->ScriptTime() +
+                                (distanceTraveled * this->animation_factor_));
+  }
+  this->last_update_ = _info.simTime;
+  ACTOR_DIAG(this->diagnostics_.update.Add(DiagnosticsClock() - update_start);)
+  ACTOR_DIAG(this->PublishDiagnostics(_info.simTime);)
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::Control(double _now, double _dt,
+                                    ignition::math::Pose3d _pose) {
+  // The step starts where the last one ended, scripted actors where their
+  // script took them
+  this->control_from_ = this->control_to_;
+  if (this->arbiter_.Mode() != ACTOR_MODE_SCRIPTED) {
+    _pose.Pos().X() = this->control_to_.x;
+    _pose.Pos().Y() = this->control_to_.y;
+  }
+  geometry_msgs::Twist twist;
+  const double start_x = _pose.Pos().X();
+  const double start_y = _pose.Pos().Y();
+
+  // The controller of the mode is chosen by a switch on its enum, so no
+  // string is compared on the update path
+  switch (this->arbiter_.Mode()) {
+    case ACTOR_MODE_SCRIPTED:
+      this->UpdateScripted(_dt, _pose, twist);
+      break;
+    case ACTOR_MODE_REPLAY:
+      this->UpdateReplay(_pose, twist);
+      break;
+    default:
+      // Velocity commands drive velocity mode, and preempt the others
+      // following the command arbitration
+      if (this->arbiter_.Arbitrate(_now, start_x, start_y))
+        this->UpdateVelocity(_dt, _pose, twist);
+      else if (this->arbiter_.Mode() == ACTOR_MODE_PATH)
+        this->UpdatePath(_now, _dt, _pose, twist);
+      else
+        this->SetAnimation(ANIMATION_STANDING);
+      break;
+  }
 
-  } else if (this->follow_mode_ == "velocity") {
-    this->trajectoryInfo_->type = WALKING_ANIMATION;
-    if (!this->cmd_queue_.empty()) {
-      this->target_vel_.Pos().X() = this->cmd_queue_.front().X();
-      this->target_vel_.Rot() =
-          ignition::math::Quaterniond(0, 0, this->cmd_queue_.front().Z());
-      this->cmd_queue_.pop();
+  // Steer around the other actors and static obstacles, which recorded
+  // actors do not
+  if (this->avoidance_ && this->arbiter_.Mode() != ACTOR_MODE_SCRIPTED &&
+      this->arbiter_.Mode() != ACTOR_MODE_REPLAY) {
+    // Built once every model of the world has been loaded
+    if (!this->avoidance_->HasObstacles()) {
+      this->avoidance_->BuildObstacles(
+          StaticObstacleFootprints(this->world_));
     }
+    double vx = twist.linear.x;
+    double vy = twist.linear.y;
+    this->avoidance_->Avoid(this->avoidance_slot_, _now, start_x, start_y, vx,
+                            vy);
+    _pose.Pos().X() += (vx - twist.linear.x) * _dt;
+    _pose.Pos().Y() += (vy - twist.linear.y) * _dt;
+    twist.linear.x = vx;
+    twist.linear.y = vy;
+  }
+
+  this->control_to_ = {_pose.Pos().X(), _pose.Pos().Y(),
+                       this->orientation_.Yaw(), twist.linear.x,
+                       twist.linear.y, twist.angular.z};
+  // Scripted actors are only measured, there is nothing to interpolate
+  if (this->arbiter_.Mode() == ACTOR_MODE_SCRIPTED)
+    this->control_from_ = this->control_to_;
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::UpdatePrediction(double _now) {
+  if (!this->ros_ready_ || !this->prediction_pub_) return;
+  // Nothing is predicted for nobody, the next subscriber gets a fresh
+  // prediction. The script of a scripted actor is not predicted.
+  if (this->arbiter_.Mode() == ACTOR_MODE_SCRIPTED ||
+      this->prediction_pub_.getNumSubscribers() == 0) {
+    this->predictor_.Clear();
+    return;
+  }
+
+  ActorPlan plan;
+  plan.mode = this->arbiter_.Preempted() ? ACTOR_MODE_VELOCITY
+                                          : this->arbiter_.Mode();
+  if (plan.mode == ACTOR_MODE_VELOCITY) {
+    plan.v = this->arbiter_.Linear();
+    plan.w = this->arbiter_.Angular();
+  } else if (plan.mode == ACTOR_MODE_PATH && !this->arbiter_.Aborted()) {
+    plan.path = this->arbiter_.Path();
+    plan.idx = this->arbiter_.Index();
+    plan.progress = this->arbiter_.Progress();
+    plan.lookahead = this->lookahead_;
+    plan.lin_tolerance = this->lin_tolerance_;
+  }
+  const double start = this->control_clock_.End();
+  if (plan.mode == ACTOR_MODE_REPLAY) {
+    plan.track = &this->replay_track_;
+    plan.time = start;
+  }
+  if (!this->predictor_.Update(this->prediction_params_, this->kernel_params_,
+                               plan, this->control_to_, start)) {
+    return;
+  }
+
+  nav_msgs::Path &msg = ReusableMessage(this->prediction_msg_);
+  msg.header.frame_id = this->odom_frame_;
+  const ros::Time now = this->lockstep_ ? ros::Time(_now) : ros::Time::now();
+  this->predictor_.Fill(now + ros::Duration(start - _now), this->orientation_,
+                        msg);
+  this->prediction_pub_.publish(this->prediction_msg_);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::HoldPose(const ignition::math::Pose3d &_pose) {
+  this->orientation_.Set(QuaternionToYaw(_pose.Rot()));
+  this->control_to_ = {_pose.Pos().X(), _pose.Pos().Y(),
+                       this->orientation_.Yaw(), 0, 0, 0};
+  this->control_from_ = this->control_to_;
+  // The pose is written again before the actor can sleep
+  this->asleep_ = false;
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::UpdatePath(double _now, double _dt,
+                                       ignition::math::Pose3d &_pose,
+                                       geometry_msgs::Twist &_twist) {
+  // Without a target the actor stands where it is
+  ignition::math::Vector3d target;
+  const bool walking = this->arbiter_.PathTarget(_now, _pose.Pos().X(),
+                                                 _pose.Pos().Y(), target);
+  if (!walking) target.Set(_pose.Pos().X(), _pose.Pos().Y(), 0);
+
+  // Rotate until facing the direction of the target, then walk along it
+  ActorStep step =
+      StepTowards(_pose.Pos().X(), _pose.Pos().Y(), this->orientation_.Yaw(),
+                  target.X(), target.Y(), this->kernel_params_, _dt);
+  this->ApplyStep(step, _pose, _twist);
+  this->SetAnimation(walking ? ANIMATION_WALKING : ANIMATION_STANDING);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::UpdateVelocity(double _dt,
+                                           ignition::math::Pose3d &_pose,
+                                           geometry_msgs::Twist &_twist) {
+  this->SetAnimation(ANIMATION_WALKING);
+  ActorStep step = StepVelocity(_pose.Pos().X(), _pose.Pos().Y(),
+                                this->orientation_.Yaw(),
+                                this->arbiter_.Linear(),
+                                this->arbiter_.Angular(), this->kernel_params_,
+                                _dt);
+  this->ApplyStep(step, _pose, _twist);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::ApplyStep(const ActorStep &_step,
+                                      ignition::math::Pose3d &_pose,
+                                      geometry_msgs::Twist &_twist) {
+  this->orientation_.Set(_step.yaw);
+  _pose.Pos().X() = _step.x;
+  _pose.Pos().Y() = _step.y;
+  _pose.Rot() = this->orientation_.Rotation();
+  _twist.linear.x = _step.vx;
+  _twist.linear.y = _step.vy;
+  _twist.angular.z = _step.wz;
+}
 
-    pose.Pos().X() += this->target_vel_.Pos().X() *
-                      cos(pose.Rot().Euler().Z() - default_rotation_) * dt;
-    pose.Pos().Y() += this->target_vel_.Pos().X() *
-                      sin(pose.Rot().Euler().Z() - default_rotation_) * dt;
-    human_odom.twist.twist.linear.x =
-        this->target_vel_.Pos().X() *
-        cos(pose.Rot().Euler().Z() - default_rotation_);
-    human_odom.twist.twist.linear.y =
-        this->target_vel_.Pos().X() *
-        sin(pose.Rot().Euler().Z() - default_rotation_);
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::UpdateScripted(double _dt,
+                                           const ignition::math::Pose3d &_pose,
+                                           geometry_msgs::Twist &_twist) {
+  // The script moved the actor since the last update, its twist is
+  // estimated from the displacement
+  this->orientation_.Set(QuaternionToYaw(_pose.Rot()));
+  if (_dt > 0) {
+    const double dyaw = this->orientation_.Yaw() - this->scripted_pose_.Z();
+    _twist.linear.x = (_pose.Pos().X() - this->scripted_pose_.X()) / _dt;
+    _twist.linear.y = (_pose.Pos().Y() - this->scripted_pose_.Y()) / _dt;
+    _twist.angular.z = WrapAngle(dyaw) / _dt;
+  }
+  this->scripted_pose_.Set(_pose.Pos().X(), _pose.Pos().Y(),
+                           this->orientation_.Yaw());
+}
 
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::UpdateReplay(ignition::math::Pose3d &_pose,
+                                         geometry_msgs::Twist &_twist) {
+  if (this->replay_track_.Empty()) {
+    this->SetAnimation(ANIMATION_STANDING);
+    return;
+  }
+  // The recording is sampled where the control step ends, the updates in
+  // between interpolate towards it
+  const ActorStep step = this->replay_track_.Sample(
+      this->control_clock_.End(), this->default_rotation_,
+      this->replay_hint_);
+  this->ApplyStep(step, _pose, _twist);
+  this->SetAnimation(step.vx == 0 && step.vy == 0 ? ANIMATION_STANDING
+                                                  : ANIMATION_WALKING);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::Record(double _now, const ActorStep &_state) {
+  if (!this->recorder_) return;
+  this->recorder_->Add(this->record_track_, _now, _state.x, _state.y,
+                       WrapAngle(_state.yaw - this->default_rotation_));
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::ApplyReset() {
+  bool teleport;
+  ignition::math::Vector3d start;
+  {
+    std::lock_guard<std::mutex> lock(this->reset_mutex_);
+    teleport = this->reset_teleport_;
+    start = this->reset_pose_;
+  }
+
+  if (teleport) {
+    // The start pose is given in the odometry frame, the actor keeps its
+    // height
+    ignition::math::Pose3d pose = this->actor_->WorldPose();
+    pose.Pos().X() = start.X();
+    pose.Pos().Y() = start.Y();
     pose.Rot() = ignition::math::Quaterniond(
-        default_rotation_, 0,
-        rpy.Z() + this->target_vel_.Rot().Euler().Z() * dt);
-    human_odom.twist.twist.angular.z = this->target_vel_.Rot().Euler().Z();
+        this->default_rotation_, 0, start.Z() + this->default_rotation_);
+    this->actor_->SetWorldPose(pose, false, false);
+  }
+  this->ResetState();
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::SwitchMode(ActorMode _mode) {
+  const ActorMode current = this->arbiter_.Mode();
+  if (_mode == current) return;
+
+  // Scripted actors play the trajectory of their SDF, the others the
+  // custom trajectory driven by the plugin
+  if (this->trajectories_.Valid()) {
+    if (_mode == ACTOR_MODE_SCRIPTED) {
+      this->animation_lod_.Resume(*this->actor_);
+      this->actor_->ResetCustomTrajectory();
+    } else if (current == ACTOR_MODE_SCRIPTED) {
+      this->actor_->SetCustomTrajectory(
+          this->trajectories_.Get(this->animation_));
+    }
+  }
+  // The plugin takes over from where the script left the actor
+  if (current == ACTOR_MODE_SCRIPTED)
+    this->HoldPose(this->actor_->WorldPose());
+  if (_mode == ACTOR_MODE_SCRIPTED) {
+    ignition::math::Pose3d pose = this->actor_->WorldPose();
+    this->scripted_pose_.Set(pose.Pos().X(), pose.Pos().Y(),
+                             this->orientation_.Yaw());
   }
+  this->arbiter_.SwitchMode(_mode);
+}
 
-  this->actor_pub_.publish(human_odom);
+/////////////////////////////////////////////////
+bool GazeboRosActorCommand::UpdateAnimationLod(
+    double _now, const ignition::math::Vector3d &_position) {
+  if (!this->lod_reference_ || !this->trajectories_.Valid()) return true;
+  // Without a reference every actor is near
+  ignition::math::Vector3d reference;
+  const bool far =
+      this->lod_reference_->Position(_now, reference) &&
+      (_position - reference).SquaredLength() >
+          this->lod_params_.distance * this->lod_params_.distance;
+  return this->animation_lod_.Update(*this->actor_, this->lod_params_, far,
+                                     _now);
+}
 
-  // Distance traveled is used to coordinate motion with the walking animation
-  auto displacement = pose.Pos() - this->actor_->WorldPose().Pos();
-  double distanceTraveled = displacement.Length();
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::SetAnimation(ActorAnimation _animation) {
+  // Each animation has its own trajectory, handed to the actor when the
+  // animation changes
+  if (!this->trajectories_.Valid() || _animation == this->animation_) return;
+  this->animation_ = _animation;
+  this->actor_->SetCustomTrajectory(this->trajectories_.Get(_animation));
+}
 
-  this->actor_->SetWorldPose(pose, false, false);
-  this->actor_->SetScriptTime(this->actor_->ScriptTime() +
-                              (distanceTraveled * this->animation_factor_));
-  this->last_update_ = _info.simTime;
+#ifdef ACTOR_DIAGNOSTICS
+void GazeboRosActorCommand::PublishDiagnostics(const common::Time &_now) {
+  if (!this->ros_ready_ || this->diagnostics_rate_ <= 0 ||
+      (_now - this->last_diagnostics_).Double() <
+          1.0 / this->diagnostics_rate_) {
+    return;
+  }
+  this->last_diagnostics_ = _now;
+
+  // Measurements cover the period since the last publication
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  msg.status.resize(1);
+  diagnostic_msgs::DiagnosticStatus &status = msg.status[0];
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.name = "actor_command: " + this->name_;
+  status.hardware_id = this->name_;
+  this->diagnostics_.Fill(status);
+  this->diagnostics_.Clear();
+  this->diagnostics_pub_.publish(msg);
 }
+#endif
 
-void GazeboRosActorCommand::ChooseNewTarget() {
-  this->idx_++;
+bool GazeboRosActorCommand::OdomDue(const common::Time &_now,
+                                    bool _asleep) const {
+  if (!this->ros_ready_) return false;
+  // Sleeping actors only keep their odometry alive
+  const double rate = _asleep ? this->idle_odom_rate_ : this->odom_rate_;
+  if (_asleep && rate <= 0) return false;
+  if (rate > 0 && (_now - this->last_odom_).Double() < 1.0 / rate) {
+    return false;
+  }
+  return !this->odom_lazy_ || this->actor_pub_.getNumSubscribers() > 0;
+}
 
-  // Set next target
-  this->target_pose_ = this->target_poses_.at(this->idx_);
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::PublishOdom(const common::Time &_now,
+                                        const ActorStep &_state,
+                                        const ActorOrientation &_orientation) {
+  // Published by pointer, so subscribers in this process get it without
+  // serialization
+  nav_msgs::Odometry &human_odom = ReusableMessage(this->odom_msg_);
+  human_odom.header.stamp = this->lockstep_
+                                ? ros::Time(_now.sec, _now.nsec)
+                                : ros::Time::now();
+  human_odom.pose.pose.position.x = _state.x;
+  human_odom.pose.pose.position.y = _state.y;
+  // Set the rotation of the human in odom
+  human_odom.pose.pose.orientation = _orientation.Heading();
+  human_odom.twist.twist.linear.x = _state.vx;
+  human_odom.twist.twist.linear.y = _state.vy;
+  human_odom.twist.twist.angular.z = _state.wz;
+  ACTOR_DIAG(const double publish_start = DiagnosticsClock();)
+  this->actor_pub_.publish(this->odom_msg_);
+  ACTOR_DIAG(this->diagnostics_.odom_publish.Add(DiagnosticsClock() -
+                                                  publish_start);)
+  this->last_odom_ = _now;
+}
+
+/////////////////////////////////////////////////
+void GazeboRosActorCommand::BroadcastTf(const common::Time &_now,
+                                        const ActorStep &_state,
+                                        const ActorOrientation &_orientation) {
+  if (!this->ros_ready_ || !this->tf_broadcaster_ ||
+      !this->tf_broadcaster_->Due(_now.Double())) {
+    return;
+  }
+  // Same pose and stamp as the odometry
+  const ros::Time stamp = this->lockstep_ ? ros::Time(_now.sec, _now.nsec)
+                                          : ros::Time::now();
+  this->tf_broadcaster_->Add(this->odom_frame_, this->base_frame_, stamp,
+                             _state.x, _state.y, _orientation.Heading());
 }
 
 void GazeboRosActorCommand::VelQueueThread() {
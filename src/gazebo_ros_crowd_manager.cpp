@@ -0,0 +1,1201 @@
+#include <gazebo_ros_actor_plugin/gazebo_ros_crowd_manager.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include <ignition/math.hh>
+#include "gazebo/physics/physics.hh"
+#include "gazebo_ros_actor_plugin/avoidance_world.h"
+
+using namespace gazebo;
+
+#define ACTOR_COMMAND_PLUGIN "gazebo_ros_actor_command"
+
+namespace {
+/// \brief Number of actors a worker thread takes at once.
+constexpr size_t kActorGrain = 16;
+
+/// \brief Number of actors a worker thread advances at once in the
+/// batched kernel, which costs little per actor.
+constexpr size_t kKernelGrain = 256;
+}  // namespace
+
+static_assert(gazebo_ros_actor_plugin::CrowdState::MODE_IDLE ==
+                      ACTOR_MODE_IDLE &&
+                  gazebo_ros_actor_plugin::CrowdState::MODE_VELOCITY ==
+                      ACTOR_MODE_VELOCITY &&
+                  gazebo_ros_actor_plugin::CrowdState::MODE_PATH ==
+                      ACTOR_MODE_PATH &&
+                  gazebo_ros_actor_plugin::CrowdState::MODE_SCRIPTED ==
+                      ACTOR_MODE_SCRIPTED &&
+                  gazebo_ros_actor_plugin::CrowdState::MODE_REPLAY ==
+                      ACTOR_MODE_REPLAY,
+              "CrowdState modes must match ActorMode");
+
+/////////////////////////////////////////////////
+GazeboRosCrowdManager::GazeboRosCrowdManager()
+    : ros_node_(nullptr),
+      ros_pending_(0),
+      ros_ready_(false),
+      dt_(0),
+      alpha_(1),
+      last_alpha_(1),
+      reset_requested_(false),
+      avoidance_enabled_(false) {}
+
+GazeboRosCrowdManager::~GazeboRosCrowdManager() {
+  // A pending registration must not create what is torn down below
+  if (this->registrar_) this->registrar_->Cancel(this);
+
+  // Drop our callbacks from the shared queue before releasing it
+  for (ManagedActor &managed : this->actors_) {
+    managed.vel_sub.shutdown();
+    managed.path_sub.shutdown();
+    managed.path_update_sub.shutdown();
+    managed.abort_sub.shutdown();
+    managed.mode_sub.shutdown();
+    managed.mode_srv.shutdown();
+  }
+  this->reset_srv_.shutdown();
+  this->command_sub_.shutdown();
+  this->shared_queue_.reset();
+
+  if (this->ros_node_) {
+    this->ros_node_->shutdown();
+    delete this->ros_node_;
+  }
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::Load(physics::WorldPtr _world,
+                                 sdf::ElementPtr _sdf) {
+  // Set default values for parameters
+  this->follow_mode_ = "velocity";
+  this->vel_topic_ = "cmd_vel";
+  this->path_topic_ = "cmd_path";
+  this->path_update_topic_ = "cmd_path_update";
+  this->path_resume_ = "start";
+  this->abort_topic_ = "abort_goal";
+  this->mode_topic_ = "cmd_mode";
+  this->command_topic_ = "actor_commands";
+  this->mode_service_ = "set_mode";
+  this->reset_service_ = "reset_actors";
+  this->lin_tolerance_ = 0.1;
+  this->lookahead_ = 0;
+  this->kernel_params_.lin_velocity = 1;
+  this->kernel_params_.ang_tolerance = IGN_DTOR(5);
+  this->kernel_params_.ang_velocity = IGN_DTOR(10);
+  this->animation_factor_ = 4.0;
+  this->kernel_params_.default_rotation = 1.57;
+  this->callback_threads_ = 1;
+  this->registration_threads_ = 4;
+  this->command_policy_ = "fifo";
+  this->command_queue_size_ = VelocityCommandBuffer::kMaxQueueSize;
+  this->command_timeout_ = 0;
+  this->command_arbitration_ = "none";
+  this->preempt_timeout_ = 1.0;
+  this->lockstep_ = false;
+  ACTOR_DIAG(this->diagnostics_rate_ = 1.0;)
+  this->sim_time_ = 0;
+  this->odom_rate_ = 0;
+  this->odom_lazy_ = true;
+  this->idle_odom_rate_ = 1.0;
+  this->odom_frame_ = "map";
+  this->base_frame_ = "base_link";
+  this->publish_tf_ = false;
+  this->tf_rate_ = 0;
+  double control_rate = 0;
+  int update_threads = 1;
+  this->crowd_state_topic_ = "crowd_state";
+  this->crowd_state_rate_ = 0;
+
+  // Override default parameter values with values from SDF
+  if (_sdf->HasElement("follow_mode")) {
+    this->follow_mode_ = _sdf->Get<std::string>("follow_mode");
+  }
+  if (_sdf->HasElement("vel_topic")) {
+    this->vel_topic_ = _sdf->Get<std::string>("vel_topic");
+  }
+  if (_sdf->HasElement("path_topic")) {
+    this->path_topic_ = _sdf->Get<std::string>("path_topic");
+  }
+  if (_sdf->HasElement("path_update_topic")) {
+    this->path_update_topic_ = _sdf->Get<std::string>("path_update_topic");
+  }
+  if (_sdf->HasElement("path_resume")) {
+    this->path_resume_ = _sdf->Get<std::string>("path_resume");
+  }
+  if (_sdf->HasElement("abort_topic")) {
+    this->abort_topic_ = _sdf->Get<std::string>("abort_topic");
+  }
+  if (_sdf->HasElement("mode_topic")) {
+    this->mode_topic_ = _sdf->Get<std::string>("mode_topic");
+  }
+  if (_sdf->HasElement("command_topic")) {
+    this->command_topic_ = _sdf->Get<std::string>("command_topic");
+  }
+  if (_sdf->HasElement("mode_service")) {
+    this->mode_service_ = _sdf->Get<std::string>("mode_service");
+  }
+  if (_sdf->HasElement("reset_service")) {
+    this->reset_service_ = _sdf->Get<std::string>("reset_service");
+  }
+  if (_sdf->HasElement("linear_tolerance")) {
+    this->lin_tolerance_ = _sdf->Get<double>("linear_tolerance");
+  }
+  if (_sdf->HasElement("lookahead_distance")) {
+    this->lookahead_ = _sdf->Get<double>("lookahead_distance");
+  }
+  if (_sdf->HasElement("linear_velocity")) {
+    this->kernel_params_.lin_velocity = _sdf->Get<double>("linear_velocity");
+  }
+  if (_sdf->HasElement("angular_tolerance")) {
+    this->kernel_params_.ang_tolerance =
+        _sdf->Get<double>("angular_tolerance");
+  }
+  if (_sdf->HasElement("angular_velocity")) {
+    this->kernel_params_.ang_velocity = _sdf->Get<double>("angular_velocity");
+  }
+  if (_sdf->HasElement("animation_factor")) {
+    this->animation_factor_ = _sdf->Get<double>("animation_factor");
+  }
+  if (_sdf->HasElement("default_rotation")) {
+    this->kernel_params_.default_rotation =
+        _sdf->Get<double>("default_rotation");
+  }
+  this->orientation_ = ActorOrientation(this->kernel_params_.default_rotation);
+  if (_sdf->HasElement("callback_threads")) {
+    this->callback_threads_ = _sdf->Get<int>("callback_threads");
+  }
+  if (_sdf->HasElement("registration_threads")) {
+    this->registration_threads_ = _sdf->Get<int>("registration_threads");
+  }
+  if (_sdf->HasElement("update_threads")) {
+    update_threads = _sdf->Get<int>("update_threads");
+  }
+  if (_sdf->HasElement("command_policy")) {
+    this->command_policy_ = _sdf->Get<std::string>("command_policy");
+  }
+  if (_sdf->HasElement("command_queue_size")) {
+    this->command_queue_size_ = _sdf->Get<int>("command_queue_size");
+  }
+  if (_sdf->HasElement("command_timeout")) {
+    this->command_timeout_ = _sdf->Get<double>("command_timeout");
+  }
+  if (_sdf->HasElement("command_arbitration")) {
+    this->command_arbitration_ =
+        _sdf->Get<std::string>("command_arbitration");
+  }
+  if (_sdf->HasElement("preempt_timeout")) {
+    this->preempt_timeout_ = _sdf->Get<double>("preempt_timeout");
+  }
+  if (_sdf->HasElement("lockstep")) {
+    this->lockstep_ = _sdf->Get<bool>("lockstep");
+  }
+#ifdef ACTOR_DIAGNOSTICS
+  if (_sdf->HasElement("diagnostics_rate")) {
+    this->diagnostics_rate_ = _sdf->Get<double>("diagnostics_rate");
+  }
+#endif
+  if (_sdf->HasElement("odom_rate")) {
+    this->odom_rate_ = _sdf->Get<double>("odom_rate");
+  }
+  if (_sdf->HasElement("idle_odom_rate")) {
+    this->idle_odom_rate_ = _sdf->Get<double>("idle_odom_rate");
+  }
+  if (_sdf->HasElement("odom_only_when_subscribed")) {
+    this->odom_lazy_ = _sdf->Get<bool>("odom_only_when_subscribed");
+  }
+  if (_sdf->HasElement("odom_frame")) {
+    this->odom_frame_ = _sdf->Get<std::string>("odom_frame");
+  }
+  if (_sdf->HasElement("base_frame")) {
+    this->base_frame_ = _sdf->Get<std::string>("base_frame");
+  }
+  if (_sdf->HasElement("publish_tf")) {
+    this->publish_tf_ = _sdf->Get<bool>("publish_tf");
+  }
+  if (_sdf->HasElement("tf_rate")) {
+    this->tf_rate_ = _sdf->Get<double>("tf_rate");
+  }
+  if (_sdf->HasElement("control_rate")) {
+    control_rate = _sdf->Get<double>("control_rate");
+  }
+  this->control_clock_.Configure(control_rate);
+  if (_sdf->HasElement("crowd_state_topic")) {
+    this->crowd_state_topic_ = _sdf->Get<std::string>("crowd_state_topic");
+  }
+  if (_sdf->HasElement("crowd_state_rate")) {
+    this->crowd_state_rate_ = _sdf->Get<double>("crowd_state_rate");
+  }
+  if (_sdf->HasElement("avoidance")) {
+    this->avoidance_enabled_ = _sdf->Get<bool>("avoidance");
+  }
+  AvoidanceParams avoidance_params;
+  LoadAvoidanceParams(_sdf, avoidance_params);
+  this->avoidance_.Configure(avoidance_params);
+  AnimationNames animation_names;
+  LoadAnimationNames(_sdf, animation_names);
+  LoadAnimationLodParams(_sdf, this->lod_params_);
+  LoadPredictionParams(_sdf, this->prediction_params_);
+  RecordingParams recording_params;
+  LoadRecordingParams(_sdf, recording_params);
+
+  // Shared by the arbiters of all actors
+  ArbiterParams arbiter_params;
+  if (!ParseActorMode(this->follow_mode_, arbiter_params.initial_mode)) {
+    gzerr << "Unknown follow mode " << this->follow_mode_
+          << ", using idle.\n";
+    arbiter_params.initial_mode = ACTOR_MODE_IDLE;
+  }
+  if (!ParseCommandArbitration(this->command_arbitration_,
+                               arbiter_params.arbitration)) {
+    gzerr << "Unknown command arbitration " << this->command_arbitration_
+          << ", using none.\n";
+    arbiter_params.arbitration = CommandArbitration::NONE;
+  }
+  arbiter_params.preempt_timeout = this->preempt_timeout_;
+  if (!ParsePathResume(this->path_resume_, arbiter_params.path_resume)) {
+    gzerr << "Unknown path resume mode " << this->path_resume_
+          << ", using start.\n";
+    arbiter_params.path_resume = ActorPath::RESUME_START;
+  }
+  arbiter_params.lockstep = this->lockstep_;
+  arbiter_params.lookahead = this->lookahead_;
+  arbiter_params.lin_tolerance = this->lin_tolerance_;
+
+  // Check if ROS node for Gazebo has been initialized
+  if (!ros::isInitialized()) {
+    ROS_FATAL_STREAM_NAMED(
+        "crowd",
+        "A ROS node for Gazebo has not been "
+            << "initialized, unable to load plugin. Load the Gazebo system "
+               "plugin "
+            << "'libgazebo_ros_api_plugin.so' in the gazebo_ros package)");
+    return;
+  }
+
+  this->sdf_ = _sdf;
+  this->world_ = _world;
+  if (this->lod_params_.distance > 0) {
+    this->lod_reference_ = AnimationLodReference::Acquire(
+        this->world_, this->lod_params_.reference);
+  }
+
+  // Collect every actor of the world, leaving out the ones that are
+  // already driven by their own GazeboRosActorCommand plugin
+  for (const physics::ModelPtr &model : this->world_->Models()) {
+    physics::ActorPtr actor =
+        boost::dynamic_pointer_cast<physics::Actor>(model);
+    if (!actor) continue;
+
+    bool has_own_plugin = false;
+    sdf::ElementPtr actor_sdf = actor->GetSDF();
+    if (actor_sdf && actor_sdf->HasElement("plugin")) {
+      for (sdf::ElementPtr plugin = actor_sdf->GetElement("plugin"); plugin;
+           plugin = plugin->GetNextElement("plugin")) {
+        if (plugin->Get<std::string>("filename").find(ACTOR_COMMAND_PLUGIN) !=
+            std::string::npos) {
+          has_own_plugin = true;
+          break;
+        }
+      }
+    }
+    if (has_own_plugin) {
+      gzmsg << "Actor " << actor->GetName()
+            << " has its own command plugin, not managing it.\n";
+      continue;
+    }
+
+    this->actors_.emplace_back();
+    ManagedActor &managed = this->actors_.back();
+    managed.actor = actor;
+    managed.name = actor->GetName();
+    managed.base_frame = this->base_frame_.empty()
+                             ? managed.name
+                             : managed.name + "/" + this->base_frame_;
+    this->actor_index_[managed.name] = this->actors_.size() - 1;
+
+    // Check if the animations exist in the actor's skeleton animations.
+    // They are looked up once, resets reuse the trajectories.
+    managed.trajectories.Resolve(actor, animation_names);
+
+    ignition::math::Pose3d pose = actor->WorldPose();
+    this->store_.Add(pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z(),
+                     QuaternionToYaw(pose.Rot()));
+  }
+  gzmsg << "Crowd manager handling " << this->actors_.size() << " actors.\n";
+  if (!recording_params.replay_file.empty()) {
+    this->replay_ = TrajectoryRecording::Acquire(recording_params.replay_file);
+    for (ManagedActor &managed : this->actors_) {
+      if (this->replay_)
+        managed.replay_track = this->replay_->Track(managed.name);
+      if (managed.replay_track.Empty()) {
+        gzerr << "No recorded trajectory of actor " << managed.name << " in "
+              << recording_params.replay_file
+              << ", it stands in replay mode.\n";
+      }
+    }
+  } else if (arbiter_params.initial_mode == ACTOR_MODE_REPLAY) {
+    gzerr << "Replay mode without replay_file, the actors stand.\n";
+  }
+  if (!recording_params.record_file.empty()) {
+    this->recorder_ = TrajectoryRecorder::Acquire(
+        recording_params.record_file, recording_params.record_rate);
+    for (ManagedActor &managed : this->actors_)
+      managed.record_track = this->recorder_->Register(managed.name);
+  }
+  if (update_threads != 1) {
+    this->workers_.reset(new ActorWorkerPool(
+        static_cast<unsigned int>(std::max(update_threads, 0))));
+    gzmsg << "Crowd manager updating actors on " << this->workers_->Threads()
+          << " threads.\n";
+  }
+
+  CommandPolicy policy = CommandPolicy::FIFO;
+  if (!ParseCommandPolicy(this->command_policy_, policy)) {
+    gzerr << "Unknown command policy " << this->command_policy_
+          << ", using fifo.\n";
+  }
+  if (this->lockstep_ && policy != CommandPolicy::STAMPED) {
+    // Commands wait for the simulation time they are stamped with
+    gzmsg << "Lockstep mode uses the stamped command policy.\n";
+    policy = CommandPolicy::STAMPED;
+  }
+  if (policy == CommandPolicy::STAMPED && !ros::Time::isSimTime()) {
+    // Stamps would be wall times, far ahead of the simulation time
+    gzerr << "The stamped command policy compares command stamps with the "
+          << "simulation time, but use_sim_time is not set. Commands stamped "
+          << "with the wall time are never applied.\n";
+  }
+  arbiter_params.policy = policy;
+  arbiter_params.queue_size = std::max(this->command_queue_size_, 1);
+  arbiter_params.command_timeout = this->command_timeout_;
+  for (ManagedActor &managed : this->actors_) {
+    managed.arbiter.Configure(managed.name, arbiter_params);
+    ACTOR_DIAG(managed.arbiter.SetDiagnostics(&managed.diagnostics);)
+  }
+
+  this->Reset();
+
+  // Create ROS node handle
+  this->ros_node_ = new ros::NodeHandle();
+  this->shared_queue_ =
+      SharedCallbackQueue::Acquire(std::max(this->callback_threads_, 1));
+
+  // Names never change, the per actor arrays are sized once here
+  if (!this->crowd_state_topic_.empty()) {
+    gazebo_ros_actor_plugin::CrowdState &msg =
+        ReusableMessage(this->crowd_msg_);
+    msg.header.frame_id = this->odom_frame_;
+    for (const ManagedActor &managed : this->actors_)
+      msg.names.push_back(managed.name);
+    const size_t n = this->actors_.size();
+    msg.x.resize(n);
+    msg.y.resize(n);
+    msg.yaw.resize(n);
+    msg.vx.resize(n);
+    msg.vy.resize(n);
+    msg.wz.resize(n);
+    msg.mode.resize(n);
+    msg.goal_index.resize(n);
+  }
+
+  // Each topic and service costs a round trip to the master. Every actor
+  // is registered on its own by threads shared with the actor plugins, so
+  // the world steps meanwhile and the round trips overlap.
+  this->ros_pending_ = this->actors_.size() + 1;
+  if (this->registration_threads_ > 0) {
+    this->registrar_ = ActorRosRegistrar::Acquire(this->registration_threads_);
+    for (size_t i = 0; i < this->actors_.size(); ++i) {
+      this->registrar_->Add(
+          this, std::bind(&GazeboRosCrowdManager::RegisterActorRos, this, i));
+    }
+    this->registrar_->Add(this,
+                          std::bind(&GazeboRosCrowdManager::RegisterRos, this));
+  } else {
+    for (size_t i = 0; i < this->actors_.size(); ++i)
+      this->RegisterActorRos(i);
+    this->RegisterRos();
+  }
+
+  // Connect the OnUpdate function to the WorldUpdateBegin event.
+  this->connections_.push_back(event::Events::ConnectWorldUpdateBegin(std::bind(
+      &GazeboRosCrowdManager::OnUpdate, this, std::placeholders::_1)));
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::RegisterActorRos(size_t _idx) {
+  // Every actor gets its own topics, all served by the shared queue
+  ManagedActor &managed = this->actors_[_idx];
+
+  ros::SubscribeOptions vel_so;
+  if (this->lockstep_) {
+    vel_so = ros::SubscribeOptions::create<geometry_msgs::TwistStamped>(
+        managed.name + "/" + this->vel_topic_, 100,
+        boost::bind(&GazeboRosCrowdManager::VelStampedCallback, this, _1,
+                    _idx),
+        ros::VoidPtr(), this->shared_queue_->Queue());
+  } else {
+    vel_so = ros::SubscribeOptions::create<geometry_msgs::Twist>(
+        managed.name + "/" + this->vel_topic_, 1,
+        boost::bind(&GazeboRosCrowdManager::VelCallback, this, _1, _idx),
+        ros::VoidPtr(), this->shared_queue_->Queue());
+  }
+  managed.vel_sub = this->ros_node_->subscribe(vel_so);
+
+  ros::SubscribeOptions path_so =
+      ros::SubscribeOptions::create<nav_msgs::Path>(
+          managed.name + "/" + this->path_topic_, 1,
+          boost::bind(&GazeboRosCrowdManager::PathCallback, this, _1, _idx),
+          ros::VoidPtr(), this->shared_queue_->Queue());
+  managed.path_sub = this->ros_node_->subscribe(path_so);
+
+  ros::SubscribeOptions path_update_so =
+      ros::SubscribeOptions::create<gazebo_ros_actor_plugin::PathUpdate>(
+          managed.name + "/" + this->path_update_topic_, 10,
+          boost::bind(&GazeboRosCrowdManager::PathUpdateCallback, this, _1,
+                      _idx),
+          ros::VoidPtr(), this->shared_queue_->Queue());
+  managed.path_update_sub = this->ros_node_->subscribe(path_update_so);
+
+  ros::SubscribeOptions abort_so =
+      ros::SubscribeOptions::create<std_msgs::Bool>(
+          managed.name + "/" + this->abort_topic_, 1,
+          boost::bind(&GazeboRosCrowdManager::AbortCallback, this, _1, _idx),
+          ros::VoidPtr(), this->shared_queue_->Queue());
+  managed.abort_sub = this->ros_node_->subscribe(abort_so);
+
+  ros::SubscribeOptions mode_so =
+      ros::SubscribeOptions::create<std_msgs::String>(
+          managed.name + "/" + this->mode_topic_, 1,
+          boost::bind(&GazeboRosCrowdManager::ModeCallback, this, _1, _idx),
+          ros::VoidPtr(), this->shared_queue_->Queue());
+  managed.mode_sub = this->ros_node_->subscribe(mode_so);
+
+  ros::AdvertiseServiceOptions mode_ao =
+      ros::AdvertiseServiceOptions::create<gazebo_ros_actor_plugin::SetMode>(
+          managed.name + "/" + this->mode_service_,
+          boost::bind(&GazeboRosCrowdManager::SetModeCallback, this, _1, _2,
+                      _idx),
+          ros::VoidPtr(), this->shared_queue_->Queue());
+  managed.mode_srv = this->ros_node_->advertiseService(mode_ao);
+
+  managed.odom_pub = this->ros_node_->advertise<nav_msgs::Odometry>(
+      managed.name + "/odom", 10);
+
+  // The prediction is only published when it changes, a late subscriber
+  // gets the latest one
+  if (this->prediction_params_.horizon > 0) {
+    managed.prediction_pub = this->ros_node_->advertise<nav_msgs::Path>(
+        managed.name + "/predicted_path", 1, true);
+  }
+  this->ros_pending_.fetch_sub(1, std::memory_order_release);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::RegisterRos() {
+  // Reset any subset of the actors in a single update
+  ros::AdvertiseServiceOptions reset_ao = ros::AdvertiseServiceOptions::create<
+      gazebo_ros_actor_plugin::ResetActors>(
+      this->reset_service_,
+      boost::bind(&GazeboRosCrowdManager::ResetCallback, this, _1, _2),
+      ros::VoidPtr(), this->shared_queue_->Queue());
+  this->reset_srv_ = this->ros_node_->advertiseService(reset_ao);
+
+  // Commands to any of the actors, batched in one message
+  if (!this->command_topic_.empty()) {
+    ros::SubscribeOptions command_so = ros::SubscribeOptions::create<
+        gazebo_ros_actor_plugin::ActorCommandArray>(
+        this->command_topic_, 100,
+        boost::bind(&GazeboRosCrowdManager::BatchedCommandCallback, this, _1),
+        ros::VoidPtr(), this->shared_queue_->Queue());
+    this->command_sub_ = this->ros_node_->subscribe(command_so);
+  }
+  ACTOR_DIAG(this->diagnostics_pub_ =
+                 this->ros_node_->advertise<diagnostic_msgs::DiagnosticArray>(
+                     "/diagnostics", 10);)
+
+  if (!this->crowd_state_topic_.empty()) {
+    this->crowd_pub_ =
+        this->ros_node_->advertise<gazebo_ros_actor_plugin::CrowdState>(
+            this->crowd_state_topic_, 1);
+  }
+
+  // The frames of all actors go in one message per update, shared with
+  // the actor plugins of the process
+  if (this->publish_tf_)
+    this->tf_broadcaster_ = ActorTfBroadcaster::Acquire(this->tf_rate_);
+  this->ros_pending_.fetch_sub(1, std::memory_order_release);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::Reset() {
+  this->last_update_ = 0;
+  this->last_odom_ = 0;
+  this->last_crowd_state_ = 0;
+  ACTOR_DIAG(this->last_diagnostics_ = 0;)
+  for (size_t i = 0; i < this->actors_.size(); ++i) this->ResetActor(i);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::ResetActor(size_t _idx) {
+  ManagedActor &managed = this->actors_[_idx];
+
+  // Take the state back from the actor's current pose
+  ignition::math::Pose3d pose = managed.actor->WorldPose();
+  this->store_.x[_idx] = pose.Pos().X();
+  this->store_.y[_idx] = pose.Pos().Y();
+  this->store_.z[_idx] = pose.Pos().Z();
+  this->store_.yaw[_idx] = QuaternionToYaw(pose.Rot());
+  this->store_.start_x[_idx] = this->store_.x[_idx];
+  this->store_.start_y[_idx] = this->store_.y[_idx];
+  this->store_.start_yaw[_idx] = this->store_.yaw[_idx];
+  this->store_.Stop(_idx);
+  managed.asleep = false;
+  managed.last_odom = 0;
+  managed.predictor.Clear();
+
+  // Forget the commands from before the reset and stand at the current
+  // pose, back in the mode of the SDF
+  managed.arbiter.Reset(pose.Pos().X(), pose.Pos().Y(),
+                        this->store_.yaw[_idx]);
+  this->store_.mode[_idx] = managed.arbiter.Mode();
+
+  managed.scripted_vel = ignition::math::Vector3d::Zero;
+  if (managed.trajectories.Valid()) {
+    managed.animation = ANIMATION_STANDING;
+
+    // Set the actor's trajectory to the custom trajectory
+    managed.actor->SetCustomTrajectory(
+        managed.trajectories.Get(managed.animation));
+  }
+  if (managed.arbiter.Mode() == ACTOR_MODE_SCRIPTED) {
+    managed.animation_lod.Resume(*managed.actor);
+    managed.actor->ResetCustomTrajectory();
+  }
+}
+
+void GazeboRosCrowdManager::VelCallback(
+    const geometry_msgs::Twist::ConstPtr &msg, size_t _idx) {
+  // Applied at the next update, whatever the policy
+  this->PushVelocity(*msg, 0, _idx);
+}
+
+void GazeboRosCrowdManager::VelStampedCallback(
+    const geometry_msgs::TwistStamped::ConstPtr &msg, size_t _idx) {
+  // Unstamped commands apply from their arrival on
+  this->PushVelocity(msg->twist, msg->header.stamp.toSec(), _idx);
+}
+
+void GazeboRosCrowdManager::PushVelocity(const geometry_msgs::Twist &_twist,
+                                         double _stamp, size_t _idx) {
+  VelocityCommand vel_cmd;
+  vel_cmd.linear = _twist.linear.x;
+  vel_cmd.angular = _twist.angular.z;
+  vel_cmd.stamp = _stamp;
+  ACTOR_DIAG(vel_cmd.received = DiagnosticsClock();)
+  ManagedActor &managed = this->actors_[_idx];
+  if (!managed.arbiter.PushVelocity(vel_cmd)) {
+    ROS_WARN_THROTTLE_NAMED(1.0, "crowd",
+                            "Velocity command queue of %s is full, "
+                            "keeping only the newest of the next commands",
+                            managed.name.c_str());
+  }
+}
+
+void GazeboRosCrowdManager::PathCallback(const nav_msgs::Path::ConstPtr &msg,
+                                         size_t _idx) {
+  this->actors_[_idx].arbiter.SetPath(msg);
+}
+
+void GazeboRosCrowdManager::BatchedCommandCallback(
+    const gazebo_ros_actor_plugin::ActorCommandArray::ConstPtr &msg) {
+  // Each command is routed through the table of names to the actor's own
+  // handling. Actors of other plugins are left to them.
+  for (size_t i = 0; i < msg->commands.size(); ++i) {
+    const gazebo_ros_actor_plugin::ActorCommand &command = msg->commands[i];
+    auto actor = this->actor_index_.find(command.name);
+    if (actor == this->actor_index_.end()) continue;
+    if (command.type == gazebo_ros_actor_plugin::ActorCommand::VELOCITY) {
+      this->PushVelocity(command.twist, CommandStamp(msg, this->lockstep_),
+                         actor->second);
+    } else if (command.type == gazebo_ros_actor_plugin::ActorCommand::PATH) {
+      this->PathCallback(CommandPath(msg, i), actor->second);
+    }
+  }
+}
+
+void GazeboRosCrowdManager::PathUpdateCallback(
+    const gazebo_ros_actor_plugin::PathUpdate::ConstPtr &msg, size_t _idx) {
+  this->actors_[_idx].arbiter.UpdatePath(msg);
+}
+
+void GazeboRosCrowdManager::ModeCallback(const std_msgs::String::ConstPtr &msg,
+                                         size_t _idx) {
+  ManagedActor &managed = this->actors_[_idx];
+  std::string message;
+  if (!managed.arbiter.RequestMode(msg->data, message)) {
+    ROS_WARN_NAMED("crowd", "%s for actor %s", message.c_str(),
+                   managed.name.c_str());
+  }
+}
+
+bool GazeboRosCrowdManager::SetModeCallback(
+    gazebo_ros_actor_plugin::SetMode::Request &_req,
+    gazebo_ros_actor_plugin::SetMode::Response &_res, size_t _idx) {
+  // Applied by the next update, like the mode topic
+  _res.success = this->actors_[_idx].arbiter.RequestMode(_req.mode,
+                                                         _res.message);
+  return true;
+}
+
+bool GazeboRosCrowdManager::ResetCallback(
+    gazebo_ros_actor_plugin::ResetActors::Request &_req,
+    gazebo_ros_actor_plugin::ResetActors::Response &_res) {
+  const size_t n =
+      _req.names.empty() ? this->actors_.size() : _req.names.size();
+  if (!_req.poses.empty() && _req.poses.size() != n) {
+    _res.success = false;
+    _res.message = "Expected one pose per actor";
+    return true;
+  }
+
+  // Resolve every name first, so a bad request resets no actor
+  std::vector<ResetRequest> resets(n);
+  for (size_t i = 0; i < n; ++i) {
+    ResetRequest &reset = resets[i];
+    reset.idx = i;
+    if (!_req.names.empty()) {
+      auto it = this->actor_index_.find(_req.names[i]);
+      if (it == this->actor_index_.end()) {
+        _res.success = false;
+        _res.message = "Unknown actor " + _req.names[i];
+        return true;
+      }
+      reset.idx = it->second;
+    }
+    reset.teleport = !_req.poses.empty();
+    if (reset.teleport) {
+      reset.x = _req.poses[i].x;
+      reset.y = _req.poses[i].y;
+      reset.yaw = _req.poses[i].theta;
+    }
+  }
+
+  // Applied together by the next update
+  {
+    std::lock_guard<std::mutex> lock(this->reset_mutex_);
+    this->pending_resets_.insert(this->pending_resets_.end(), resets.begin(),
+                                 resets.end());
+  }
+  this->reset_requested_ = true;
+  _res.success = true;
+  _res.message = "Resetting " + std::to_string(n) + " actors";
+  return true;
+}
+
+void GazeboRosCrowdManager::AbortCallback(const std_msgs::Bool::ConstPtr &msg,
+                                          size_t _idx) {
+  this->actors_[_idx].arbiter.Abort(msg->data);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::OnUpdate(const common::UpdateInfo &_info) {
+  ACTOR_DIAG(const double update_start = DiagnosticsClock();)
+
+  // Time delta, shared by all actors
+  double dt = (_info.simTime - this->last_update_).Double();
+  this->sim_time_ = _info.simTime.Double();
+
+  // Reset the actors requested since the last update before anything else
+  if (this->reset_requested_.exchange(false)) this->ApplyResets();
+
+  // Publishers are only used once every registration is done
+  if (!this->ros_ready_)
+    this->ros_ready_ = this->ros_pending_.load(std::memory_order_acquire) == 0;
+
+  // At a control tick, pull commands and path targets into the state
+  // store and advance every actor in one batch by a control step. Every
+  // update then writes back the poses part of the way through the step.
+  // Only the phases calling Gazebo run on the physics thread alone.
+  if (this->control_clock_.Tick(this->sim_time_, dt, this->dt_)) {
+    for (size_t i = 0; i < this->actors_.size(); ++i) {
+      ACTOR_DIAG(const double sync_start = DiagnosticsClock();)
+      this->SyncActor(i);
+      ACTOR_DIAG(this->actors_[i].work_time =
+                     DiagnosticsClock() - sync_start;)
+    }
+    this->ForEachActor(kActorGrain, [this](size_t _i) {
+      ACTOR_DIAG(const double prepare_start = DiagnosticsClock();)
+      this->PrepareActor(_i);
+      ACTOR_DIAG(this->actors_[_i].work_time +=
+                 DiagnosticsClock() - prepare_start;)
+    });
+    this->last_alpha_ = 0;
+
+    ACTOR_DIAG(const double kernel_start = DiagnosticsClock();)
+    if (this->workers_) {
+      this->workers_->ParallelFor(
+          this->store_.Size(), kKernelGrain,
+          [this](size_t _begin, size_t _end) {
+            UpdateActorStates(this->store_, this->kernel_params_, this->dt_,
+                              _begin, _end);
+          });
+    } else {
+      UpdateActorStates(this->store_, this->kernel_params_, this->dt_);
+    }
+
+    // Steer the actors around each other and static obstacles
+    if (this->avoidance_enabled_) {
+      // Built once every model of the world has been loaded
+      if (!this->avoidance_.HasObstacles())
+        this->avoidance_.BuildObstacles(
+            StaticObstacleFootprints(this->world_));
+      this->avoidance_.Apply(this->store_, this->dt_, this->workers_.get());
+    }
+    // Replayed actors take their recorded pose whatever the kernel did
+    if (this->replay_) {
+      this->ForEachActor(kActorGrain,
+                         [this](size_t _i) { this->ReplayActor(_i); });
+    }
+    ACTOR_DIAG(this->kernel_time_.Add(DiagnosticsClock() - kernel_start);)
+
+    // Predictions start where the actors end the control step
+    if (this->prediction_params_.horizon > 0) {
+      const ros::Time end =
+          this->Stamp(_info.simTime) +
+          ros::Duration(this->control_clock_.End() - this->sim_time_);
+      this->ForEachActor(kActorGrain, [this, &end](size_t _i) {
+        this->UpdatePrediction(_i, end);
+      });
+    }
+  }
+  this->alpha_ = this->control_clock_.Alpha(this->sim_time_);
+  // Without a reference every actor is near
+  this->lod_valid_ = this->lod_reference_ &&
+                     this->lod_reference_->Position(this->sim_time_,
+                                                    this->lod_position_);
+
+  const bool publish_odom =
+      this->odom_rate_ <= 0 ||
+      (_info.simTime - this->last_odom_).Double() >= 1.0 / this->odom_rate_;
+  if (publish_odom) this->last_odom_ = _info.simTime;
+  const bool publish_tf = this->ros_ready_ && this->tf_broadcaster_ &&
+                          this->tf_broadcaster_->Due(this->sim_time_);
+
+  // Sleeping actors may keep their odometry alive at any update
+  const ros::Time stamp = this->Stamp(_info.simTime);
+  this->ForEachActor(kActorGrain, [&](size_t _i) {
+    ACTOR_DIAG(const double compute_start = DiagnosticsClock();)
+    this->ComputeActor(_i, stamp, publish_odom, publish_tf);
+    ACTOR_DIAG(this->actors_[_i].work_time +=
+               DiagnosticsClock() - compute_start;)
+  });
+  for (size_t i = 0; i < this->actors_.size(); ++i) {
+    ACTOR_DIAG(const double commit_start = DiagnosticsClock();)
+    this->CommitActor(i, stamp, publish_tf);
+    // The share of the actor in the update, without the batched kernel
+    ACTOR_DIAG(ManagedActor &managed = this->actors_[i];
+               managed.diagnostics.update.Add(managed.work_time +
+                                              DiagnosticsClock() -
+                                              commit_start);
+               managed.work_time = 0;)
+  }
+  this->last_alpha_ = this->alpha_;
+
+  // Aggregated state of every actor, taken after this update
+  if (this->ros_ready_ && this->crowd_pub_ &&
+      this->crowd_pub_.getNumSubscribers() > 0 &&
+      (this->crowd_state_rate_ <= 0 ||
+       (_info.simTime - this->last_crowd_state_).Double() >=
+           1.0 / this->crowd_state_rate_)) {
+    this->PublishCrowdState(publish_odom ? stamp
+                                         : this->Stamp(_info.simTime));
+    this->last_crowd_state_ = _info.simTime;
+  }
+
+  this->last_update_ = _info.simTime;
+  ACTOR_DIAG(this->update_time_.Add(DiagnosticsClock() - update_start);)
+  ACTOR_DIAG(this->PublishDiagnostics(_info.simTime);)
+}
+
+/////////////////////////////////////////////////
+ros::Time GazeboRosCrowdManager::Stamp(const common::Time &_sim_time) const {
+  // In lockstep mode messages are stamped with the update they come from,
+  // not with the last /clock received
+  if (this->lockstep_) return ros::Time(_sim_time.sec, _sim_time.nsec);
+  return ros::Time::now();
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::SyncActor(size_t _idx) {
+  ManagedActor &managed = this->actors_[_idx];
+  ActorStateStore &store = this->store_;
+
+  // Walk the animation through what the updates since the last tick left
+  // of the previous control step
+  if (managed.trajectories.Valid() &&
+      store.mode[_idx] != ACTOR_MODE_SCRIPTED) {
+    managed.actor->SetScriptTime(
+        managed.actor->ScriptTime() + (1 - this->last_alpha_) *
+                                          store.travelled[_idx] *
+                                          this->animation_factor_);
+  }
+
+  // Switch to a mode requested since the last update
+  ActorMode requested;
+  if (managed.arbiter.TakeRequestedMode(requested))
+    this->SwitchMode(_idx, requested);
+
+  if (managed.arbiter.Mode() == ACTOR_MODE_SCRIPTED) {
+    // The script moved the actor since the last update, take its pose back
+    ignition::math::Pose3d pose = managed.actor->WorldPose();
+    const double yaw = QuaternionToYaw(pose.Rot());
+    if (this->dt_ > 0) {
+      const double dyaw = yaw - store.yaw[_idx];
+      managed.scripted_vel.Set((pose.Pos().X() - store.x[_idx]) / this->dt_,
+                               (pose.Pos().Y() - store.y[_idx]) / this->dt_,
+                               WrapAngle(dyaw) / this->dt_);
+    }
+    store.x[_idx] = pose.Pos().X();
+    store.y[_idx] = pose.Pos().Y();
+    store.z[_idx] = pose.Pos().Z();
+    store.yaw[_idx] = yaw;
+  }
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::PrepareActor(size_t _idx) {
+  ManagedActor &managed = this->actors_[_idx];
+  ActorStateStore &store = this->store_;
+
+  ACTOR_DIAG(managed.diagnostics.queue_depth.Add(
+                 managed.arbiter.PendingCommands());)
+
+  // The store follows velocity commands while they preempt the mode.
+  // Scripted actors were read back by SyncActor, replayed ones are moved
+  // after the kernel.
+  const ActorMode mode = managed.arbiter.Mode();
+  store.mode[_idx] = mode;
+  if (mode == ACTOR_MODE_SCRIPTED || mode == ACTOR_MODE_REPLAY) return;
+  const bool velocity =
+      managed.arbiter.Arbitrate(this->sim_time_, store.x[_idx], store.y[_idx]);
+  store.v[_idx] = managed.arbiter.Linear();
+  store.w[_idx] = managed.arbiter.Angular();
+  if (velocity) {
+    store.mode[_idx] = ACTOR_MODE_VELOCITY;
+  } else if (mode == ACTOR_MODE_PATH) {
+    ignition::math::Vector3d target;
+    store.has_target[_idx] = managed.arbiter.PathTarget(
+        this->sim_time_, store.x[_idx], store.y[_idx], target);
+    if (store.has_target[_idx]) {
+      store.target_x[_idx] = target.X();
+      store.target_y[_idx] = target.Y();
+      store.target_yaw[_idx] = target.Z();
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::ComputeActor(size_t _idx, const ros::Time &_stamp,
+                                         bool _publish_odom,
+                                         bool _publish_tf) {
+  ManagedActor &managed = this->actors_[_idx];
+  const ActorStateStore &store = this->store_;
+  managed.move = false;
+  if (!managed.trajectories.Valid()) return;
+
+  // Scripted actors are moved by their own trajectory
+  const bool scripted = store.mode[_idx] == ACTOR_MODE_SCRIPTED;
+
+  // An actor standing still over a whole control step sleeps once its pose
+  // has been written, until a command moves it again: its pose is left as
+  // it is and its odometry is only kept alive
+  const bool still = !scripted && store.Still(_idx);
+  const bool asleep = still && managed.asleep;
+  managed.asleep = still;
+  if (asleep) {
+    _publish_odom =
+        this->idle_odom_rate_ > 0 &&
+        this->sim_time_ - managed.last_odom >= 1.0 / this->idle_odom_rate_;
+  }
+
+  managed.state = store.Interpolate(_idx, this->alpha_);
+  managed.orientation = this->orientation_;
+  const ActorStep &state = managed.state;
+  ActorOrientation &orientation = managed.orientation;
+  if (!asleep || _publish_odom || _publish_tf) orientation.Set(state.yaw);
+  managed.move = !scripted && !asleep;
+
+  if (!_publish_odom || !this->ros_ready_ ||
+      (this->odom_lazy_ && managed.odom_pub.getNumSubscribers() == 0)) {
+    return;
+  }
+
+  // Published by pointer, so subscribers in this process get it without
+  // serialization
+  nav_msgs::Odometry &odom = ReusableMessage(managed.odom_msg);
+  odom.header.frame_id = this->odom_frame_;
+  odom.child_frame_id = managed.base_frame;
+  odom.header.stamp = _stamp;
+  odom.pose.pose.position.x = state.x;
+  odom.pose.pose.position.y = state.y;
+  odom.pose.pose.orientation = orientation.Heading();
+  odom.twist.twist.linear.x =
+      scripted ? managed.scripted_vel.X() : state.vx;
+  odom.twist.twist.linear.y =
+      scripted ? managed.scripted_vel.Y() : state.vy;
+  odom.twist.twist.angular.z =
+      scripted ? managed.scripted_vel.Z() : state.wz;
+  ACTOR_DIAG(const double publish_start = DiagnosticsClock();)
+  managed.odom_pub.publish(managed.odom_msg);
+  ACTOR_DIAG(managed.diagnostics.odom_publish.Add(DiagnosticsClock() -
+                                                  publish_start);)
+  managed.last_odom = this->sim_time_;
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::CommitActor(size_t _idx, const ros::Time &_stamp,
+                                        bool _publish_tf) {
+  ManagedActor &managed = this->actors_[_idx];
+  const ActorStateStore &store = this->store_;
+  if (!managed.trajectories.Valid()) return;
+
+  const ActorStep &state = managed.state;
+  if (managed.move) {
+    const bool standing =
+        store.mode[_idx] == ACTOR_MODE_IDLE ||
+        (store.mode[_idx] == ACTOR_MODE_PATH && !store.has_target[_idx]) ||
+        (store.mode[_idx] == ACTOR_MODE_REPLAY && store.travelled[_idx] == 0);
+    this->SetAnimation(_idx,
+                       standing ? ANIMATION_STANDING : ANIMATION_WALKING);
+
+    ignition::math::Pose3d pose(
+        ignition::math::Vector3d(state.x, state.y, store.z[_idx]),
+        managed.orientation.Rotation());
+    // Distant actors skip skeleton refreshes, their root pose is then
+    // published on its own
+    bool animated = true;
+    if (this->lod_reference_) {
+      const bool far = this->lod_valid_ &&
+                       (pose.Pos() - this->lod_position_).SquaredLength() >
+                           this->lod_params_.distance *
+                               this->lod_params_.distance;
+      animated = managed.animation_lod.Update(*managed.actor,
+                                              this->lod_params_, far,
+                                              this->sim_time_);
+    }
+    managed.actor->SetWorldPose(pose, false, !animated);
+
+    // Distance traveled is used to coordinate motion with the walking
+    // animation
+    managed.actor->SetScriptTime(
+        managed.actor->ScriptTime() + (this->alpha_ - this->last_alpha_) *
+                                          store.travelled[_idx] *
+                                          this->animation_factor_);
+  }
+
+  // The frame follows even a sleeping actor, as TF listeners need it
+  // every broadcast
+  if (_publish_tf) {
+    this->tf_broadcaster_->Add(this->odom_frame_, managed.base_frame, _stamp,
+                               state.x, state.y,
+                               managed.orientation.Heading());
+  }
+  if (this->recorder_) {
+    this->recorder_->Add(managed.record_track, this->sim_time_, state.x,
+                         state.y,
+                         WrapAngle(state.yaw -
+                                   this->kernel_params_.default_rotation));
+  }
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::ReplayActor(size_t _idx) {
+  ManagedActor &managed = this->actors_[_idx];
+  ActorStateStore &store = this->store_;
+  if (store.mode[_idx] != ACTOR_MODE_REPLAY || managed.replay_track.Empty())
+    return;
+
+  // The kernel left the actor where its last step ended, which the step
+  // to the recorded pose starts from
+  const ActorStep step = managed.replay_track.Sample(
+      this->control_clock_.End(), this->kernel_params_.default_rotation,
+      managed.replay_hint);
+  store.x[_idx] = step.x;
+  store.y[_idx] = step.y;
+  store.yaw[_idx] = step.yaw;
+  store.vel_x[_idx] = step.vx;
+  store.vel_y[_idx] = step.vy;
+  store.vel_yaw[_idx] = step.wz;
+  store.travelled[_idx] =
+      std::hypot(step.x - store.start_x[_idx], step.y - store.start_y[_idx]);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::UpdatePrediction(size_t _idx,
+                                             const ros::Time &_stamp) {
+  ManagedActor &managed = this->actors_[_idx];
+  const ActorStateStore &store = this->store_;
+  // Nothing is predicted for nobody, the next subscriber gets a fresh
+  // prediction. The script of a scripted actor is not predicted.
+  if (store.mode[_idx] == ACTOR_MODE_SCRIPTED || !this->ros_ready_ ||
+      managed.prediction_pub.getNumSubscribers() == 0) {
+    managed.predictor.Clear();
+    return;
+  }
+
+  // The store holds the velocity mode while velocity commands preempt
+  ActorPlan plan;
+  plan.mode = static_cast<ActorMode>(store.mode[_idx]);
+  if (plan.mode == ACTOR_MODE_VELOCITY) {
+    plan.v = store.v[_idx];
+    plan.w = store.w[_idx];
+  } else if (plan.mode == ACTOR_MODE_PATH && !managed.arbiter.Aborted()) {
+    plan.path = managed.arbiter.Path();
+    plan.idx = managed.arbiter.Index();
+    plan.progress = managed.arbiter.Progress();
+    plan.lookahead = this->lookahead_;
+    plan.lin_tolerance = this->lin_tolerance_;
+  } else if (plan.mode == ACTOR_MODE_REPLAY) {
+    plan.track = &managed.replay_track;
+    plan.time = this->control_clock_.End();
+  }
+  const ActorStep state = {store.x[_idx],     store.y[_idx],
+                           store.yaw[_idx],   store.vel_x[_idx],
+                           store.vel_y[_idx], store.vel_yaw[_idx]};
+  if (!managed.predictor.Update(this->prediction_params_, this->kernel_params_,
+                                plan, state, this->control_clock_.End())) {
+    return;
+  }
+
+  nav_msgs::Path &msg = ReusableMessage(managed.prediction_msg);
+  msg.header.frame_id = this->odom_frame_;
+  managed.predictor.Fill(_stamp, this->orientation_, msg);
+  managed.prediction_pub.publish(managed.prediction_msg);
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::ApplyResets() {
+  std::vector<ResetRequest> resets;
+  {
+    std::lock_guard<std::mutex> lock(this->reset_mutex_);
+    resets.swap(this->pending_resets_);
+  }
+
+  const double rot = this->kernel_params_.default_rotation;
+  for (const ResetRequest &reset : resets) {
+    ManagedActor &managed = this->actors_[reset.idx];
+    if (reset.teleport) {
+      // The start pose is given in the odometry frame, the actor keeps its
+      // height
+      ignition::math::Pose3d pose = managed.actor->WorldPose();
+      pose.Pos().X() = reset.x;
+      pose.Pos().Y() = reset.y;
+      pose.Rot() = ignition::math::Quaterniond(rot, 0, reset.yaw + rot);
+      managed.actor->SetWorldPose(pose, false, false);
+    }
+    this->ResetActor(reset.idx);
+  }
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::SwitchMode(size_t _idx, ActorMode _mode) {
+  ManagedActor &managed = this->actors_[_idx];
+  ActorStateStore &store = this->store_;
+  const ActorMode current = managed.arbiter.Mode();
+  if (_mode == current) return;
+
+  // Scripted actors play the trajectory of their SDF, the others the
+  // custom trajectory driven by the manager
+  if (managed.trajectories.Valid()) {
+    if (_mode == ACTOR_MODE_SCRIPTED) {
+      managed.animation_lod.Resume(*managed.actor);
+      managed.actor->ResetCustomTrajectory();
+    } else if (current == ACTOR_MODE_SCRIPTED) {
+      managed.actor->SetCustomTrajectory(
+          managed.trajectories.Get(managed.animation));
+    }
+  }
+  managed.scripted_vel = ignition::math::Vector3d::Zero;
+  managed.asleep = false;
+
+  managed.arbiter.SwitchMode(_mode);
+  store.mode[_idx] = _mode;
+}
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::SetAnimation(size_t _idx,
+                                         ActorAnimation _animation) {
+  // Each animation has its own trajectory, handed to the actor when the
+  // animation changes
+  ManagedActor &managed = this->actors_[_idx];
+  if (!managed.trajectories.Valid() || _animation == managed.animation)
+    return;
+  managed.animation = _animation;
+  managed.actor->SetCustomTrajectory(managed.trajectories.Get(_animation));
+}
+
+#ifdef ACTOR_DIAGNOSTICS
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::PublishDiagnostics(const common::Time &_now) {
+  if (!this->ros_ready_ || this->diagnostics_rate_ <= 0 ||
+      (_now - this->last_diagnostics_).Double() <
+          1.0 / this->diagnostics_rate_) {
+    return;
+  }
+  this->last_diagnostics_ = _now;
+
+  // Measurements cover the period since the last publication: one status
+  // for the whole crowd, then one per actor
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  msg.status.resize(this->actors_.size() + 1);
+  diagnostic_msgs::DiagnosticStatus &crowd = msg.status[0];
+  crowd.level = diagnostic_msgs::DiagnosticStatus::OK;
+  crowd.name = "crowd_manager";
+  AddHistogram("update", this->update_time_, crowd);
+  AddHistogram("kernel", this->kernel_time_, crowd);
+  this->update_time_.Clear();
+  this->kernel_time_.Clear();
+
+  for (size_t i = 0; i < this->actors_.size(); ++i) {
+    ManagedActor &managed = this->actors_[i];
+    diagnostic_msgs::DiagnosticStatus &status = msg.status[i + 1];
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = "crowd_manager: " + managed.name;
+    status.hardware_id = managed.name;
+    managed.diagnostics.Fill(status);
+    managed.diagnostics.Clear();
+  }
+  this->diagnostics_pub_.publish(msg);
+}
+#endif
+
+/////////////////////////////////////////////////
+void GazeboRosCrowdManager::PublishCrowdState(const ros::Time &_stamp) {
+  const ActorStateStore &store = this->store_;
+  gazebo_ros_actor_plugin::CrowdState &msg = ReusableMessage(this->crowd_msg_);
+  const double rot = this->kernel_params_.default_rotation;
+
+  msg.header.stamp = _stamp;
+  for (size_t i = 0; i < this->actors_.size(); ++i) {
+    const ActorStep state = store.Interpolate(i, this->alpha_);
+    msg.x[i] = state.x;
+    msg.y[i] = state.y;
+    msg.yaw[i] = WrapAngle(state.yaw - rot);
+    msg.vx[i] = state.vx;
+    msg.vy[i] = state.vy;
+    msg.wz[i] = state.wz;
+    msg.mode[i] = store.mode[i];
+    msg.goal_index[i] =
+        store.mode[i] == ACTOR_MODE_PATH && store.has_target[i]
+            ? static_cast<int32_t>(this->actors_[i].arbiter.Index())
+            : -1;
+  }
+  this->crowd_pub_.publish(this->crowd_msg_);
+}
+
+GZ_REGISTER_WORLD_PLUGIN(GazeboRosCrowdManager)
@@ -0,0 +1,33 @@
+#include <gazebo_ros_actor_plugin/shared_callback_queue.h>
+
+#include <mutex>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+std::shared_ptr<SharedCallbackQueue> SharedCallbackQueue::Acquire(
+    unsigned int _threads) {
+  static std::mutex mutex;
+  static std::weak_ptr<SharedCallbackQueue> instance;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<SharedCallbackQueue> queue = instance.lock();
+  if (!queue) {
+    queue.reset(new SharedCallbackQueue(_threads));
+    instance = queue;
+  }
+  return queue;
+}
+
+/////////////////////////////////////////////////
+SharedCallbackQueue::SharedCallbackQueue(unsigned int _threads)
+    : spinner_(new ros::AsyncSpinner(_threads, &queue_)) {
+  this->spinner_->start();
+}
+
+/////////////////////////////////////////////////
+SharedCallbackQueue::~SharedCallbackQueue() {
+  this->spinner_->stop();
+  this->queue_.disable();
+  this->queue_.clear();
+}
@@ -0,0 +1,149 @@
+#include <gazebo_ros_actor_plugin/trajectory_prediction.h>
+
+#include <cmath>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+void gazebo::LoadPredictionParams(const sdf::ElementPtr &_sdf,
+                                  PredictionParams &_params) {
+  if (_sdf->HasElement("prediction_horizon")) {
+    _params.horizon = _sdf->Get<double>("prediction_horizon");
+  }
+  if (_sdf->HasElement("prediction_step")) {
+    _params.step = _sdf->Get<double>("prediction_step");
+  }
+  if (_sdf->HasElement("prediction_tolerance")) {
+    _params.tolerance = _sdf->Get<double>("prediction_tolerance");
+  }
+}
+
+/////////////////////////////////////////////////
+void gazebo::PredictTrajectory(ActorPlan _plan,
+                               const ActorKernelParams &_params,
+                               const ActorStep &_start, double _step,
+                               size_t _count, std::vector<ActorStep> &_poses) {
+  _poses.clear();
+  if (_count == 0) return;
+  _poses.reserve(_count);
+  _poses.push_back(_start);
+
+  // The future of a replayed actor is read from its recording
+  if (_plan.mode == ACTOR_MODE_REPLAY && _plan.track &&
+      !_plan.track->Empty()) {
+    size_t hint = 0;
+    while (_poses.size() < _count) {
+      _poses.push_back(_plan.track->Sample(
+          _plan.time + _poses.size() * _step, _params.default_rotation,
+          hint));
+    }
+    return;
+  }
+
+  const ActorPath *path = _plan.path.get();
+  bool standing = _plan.mode == ACTOR_MODE_IDLE ||
+                  _plan.mode == ACTOR_MODE_REPLAY ||
+                  (_plan.mode == ACTOR_MODE_PATH && (!path || path->Empty()));
+  ActorStep pose = _start;
+  while (_poses.size() < _count && !standing) {
+    if (_plan.mode == ACTOR_MODE_VELOCITY) {
+      pose = StepVelocity(pose.x, pose.y, pose.yaw, _plan.v, _plan.w, _params,
+                          _step);
+      _poses.push_back(pose);
+      continue;
+    }
+
+    // Same choice of target as the path controllers
+    ignition::math::Vector3d target;
+    if (_plan.lookahead > 0 && path->Size() > 1) {
+      PathPoint point =
+          path->Lookahead(pose.x, pose.y, _plan.lookahead, _plan.progress);
+      _plan.idx = point.index;
+      target.Set(point.x, point.y, point.yaw);
+    } else {
+      target = path->At(_plan.idx);
+    }
+    if (std::hypot(target.X() - pose.x, target.Y() - pose.y) <
+        _plan.lin_tolerance) {
+      if (_plan.idx + 1 >= path->Size()) {
+        standing = true;
+        break;
+      }
+      target = path->At(++_plan.idx);
+    }
+    pose = StepTowards(pose.x, pose.y, pose.yaw, target.X(), target.Y(),
+                       _params, _step);
+    _poses.push_back(pose);
+  }
+
+  // An actor standing still stays where it is until the end of the horizon
+  pose.vx = 0;
+  pose.vy = 0;
+  pose.wz = 0;
+  _poses.resize(_count, pose);
+}
+
+/////////////////////////////////////////////////
+bool TrajectoryPredictor::Update(const PredictionParams &_params,
+                                 const ActorKernelParams &_kernel_params,
+                                 const ActorPlan &_plan,
+                                 const ActorStep &_state, double _time) {
+  if (_params.horizon <= 0 || _params.step <= 0) return false;
+  if (this->Holds(_params, _plan, _state, _time)) return false;
+
+  const size_t count =
+      static_cast<size_t>(std::ceil(_params.horizon / _params.step)) + 1;
+  PredictTrajectory(_plan, _kernel_params, _state, _params.step, count,
+                    this->poses_);
+  this->plan_ = _plan;
+  this->start_ = _time;
+  this->step_ = _params.step;
+  this->valid_ = true;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool TrajectoryPredictor::Holds(const PredictionParams &_params,
+                                const ActorPlan &_plan,
+                                const ActorStep &_state, double _time) const {
+  // A new command or path changes the whole future, progress along the
+  // same path does not
+  if (!this->valid_ || _plan.mode != this->plan_.mode ||
+      _plan.v != this->plan_.v || _plan.w != this->plan_.w ||
+      _plan.path != this->plan_.path || _plan.track != this->plan_.track ||
+      _params.step != this->step_) {
+    return false;
+  }
+
+  // Half of the horizon is always left ahead of the actor
+  const double elapsed = _time - this->start_;
+  if (elapsed < 0 || elapsed > 0.5 * _params.horizon) return false;
+  const double k = elapsed / this->step_;
+  const size_t i = static_cast<size_t>(k);
+  if (i + 1 >= this->poses_.size()) return false;
+
+  const ActorStep expected =
+      InterpolateStep(this->poses_[i], this->poses_[i + 1], k - i);
+  const double dyaw = WrapAngle(_state.yaw - expected.yaw);
+  return std::hypot(_state.x - expected.x, _state.y - expected.y) <=
+             _params.tolerance &&
+         std::abs(dyaw) <= _params.tolerance;
+}
+
+/////////////////////////////////////////////////
+void TrajectoryPredictor::Fill(const ros::Time &_stamp,
+                               ActorOrientation _orientation,
+                               nav_msgs::Path &_msg) const {
+  _msg.header.stamp = _stamp;
+  _msg.poses.resize(this->poses_.size());
+  for (size_t i = 0; i < this->poses_.size(); ++i) {
+    const ActorStep &step = this->poses_[i];
+    geometry_msgs::PoseStamped &pose = _msg.poses[i];
+    pose.header.frame_id = _msg.header.frame_id;
+    pose.header.stamp = _stamp + ros::Duration(i * this->step_);
+    pose.pose.position.x = step.x;
+    pose.pose.position.y = step.y;
+    _orientation.Set(step.yaw);
+    pose.pose.orientation = _orientation.Heading();
+  }
+}
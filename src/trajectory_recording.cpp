@@ -0,0 +1,262 @@
+#include <gazebo_ros_actor_plugin/trajectory_recording.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "gazebo/common/Console.hh"
+
+using namespace gazebo;
+
+namespace {
+/// \brief Number of poses sampling looks ahead of its hint, before
+/// searching the whole track.
+constexpr size_t kHintWalk = 8;
+}  // namespace
+
+/////////////////////////////////////////////////
+void gazebo::LoadRecordingParams(const sdf::ElementPtr &_sdf,
+                                 RecordingParams &_params) {
+  if (_sdf->HasElement("replay_file")) {
+    _params.replay_file = _sdf->Get<std::string>("replay_file");
+  }
+  if (_sdf->HasElement("record_file")) {
+    _params.record_file = _sdf->Get<std::string>("record_file");
+  }
+  if (_sdf->HasElement("record_rate")) {
+    _params.record_rate = _sdf->Get<double>("record_rate");
+  }
+}
+
+/////////////////////////////////////////////////
+ActorStep RecordedTrack::Sample(double _time, double _default_rotation,
+                                size_t &_hint) const {
+  ActorStep step = {0, 0, _default_rotation, 0, 0, 0};
+  if (this->count_ == 0) return step;
+
+  // Replay moves the hint by a pose or so per update, a jump in time
+  // searches the whole track
+  const RecordedPose *poses = this->poses_;
+  if (_hint >= this->count_ || poses[_hint].time > _time ||
+      (_hint + kHintWalk < this->count_ &&
+       poses[_hint + kHintWalk].time <= _time)) {
+    const RecordedPose *next = std::upper_bound(
+        poses, poses + this->count_, _time,
+        [](double _t, const RecordedPose &_pose) { return _t < _pose.time; });
+    _hint = next == poses ? 0 : next - poses - 1;
+  } else {
+    while (_hint + 1 < this->count_ && poses[_hint + 1].time <= _time)
+      ++_hint;
+  }
+
+  const RecordedPose &from = poses[_hint];
+  step.x = from.x;
+  step.y = from.y;
+  step.yaw = WrapAngle(from.yaw + _default_rotation);
+  if (_time < from.time || _hint + 1 >= this->count_) return step;
+
+  const RecordedPose &to = poses[_hint + 1];
+  const double dt = to.time - from.time;
+  const double alpha = (_time - from.time) / dt;
+  const double dyaw = WrapAngle(to.yaw - from.yaw);
+  step.x += alpha * (to.x - from.x);
+  step.y += alpha * (to.y - from.y);
+  step.yaw = WrapAngle(step.yaw + alpha * dyaw);
+  step.vx = (to.x - from.x) / dt;
+  step.vy = (to.y - from.y) / dt;
+  step.wz = dyaw / dt;
+  return step;
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<const TrajectoryRecording> TrajectoryRecording::Acquire(
+    const std::string &_path) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<const TrajectoryRecording>>
+      instances;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<const TrajectoryRecording> recording =
+      instances[_path].lock();
+  if (!recording) {
+    std::shared_ptr<TrajectoryRecording> opened(new TrajectoryRecording());
+    if (!opened->Open(_path)) return nullptr;
+    gzmsg << "Replaying " << opened->Size() << " actors from " << _path
+          << ".\n";
+    recording = opened;
+    instances[_path] = recording;
+  }
+  return recording;
+}
+
+/////////////////////////////////////////////////
+TrajectoryRecording::~TrajectoryRecording() {
+  if (this->data_) munmap(this->data_, this->size_);
+}
+
+/////////////////////////////////////////////////
+bool TrajectoryRecording::Open(const std::string &_path) {
+  const int fd = open(_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    gzerr << "Cannot open recording " << _path << ": " << std::strerror(errno)
+          << "\n";
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(RecordingHeader)) {
+    gzerr << "Recording " << _path << " is too short.\n";
+    close(fd);
+    return false;
+  }
+  this->size_ = info.st_size;
+  void *data = mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    gzerr << "Cannot map recording " << _path << ": "
+          << std::strerror(errno) << "\n";
+    return false;
+  }
+  this->data_ = data;
+
+  // Every entry and track must lie within the file
+  const char *bytes = static_cast<const char *>(this->data_);
+  const RecordingHeader *header =
+      reinterpret_cast<const RecordingHeader *>(bytes);
+  const size_t available =
+      (this->size_ - sizeof(RecordingHeader)) / sizeof(RecordingEntry);
+  if (std::memcmp(header->magic, RecordingHeader::kMagic,
+                  sizeof(header->magic)) != 0 ||
+      header->actor_count > available) {
+    gzerr << "File " << _path << " is not an actor recording.\n";
+    return false;
+  }
+  const RecordingEntry *entries = reinterpret_cast<const RecordingEntry *>(
+      bytes + sizeof(RecordingHeader));
+  const size_t poses_start = sizeof(RecordingHeader) +
+                             header->actor_count * sizeof(RecordingEntry);
+  const RecordedPose *poses =
+      reinterpret_cast<const RecordedPose *>(bytes + poses_start);
+  const uint64_t pose_count =
+      (this->size_ - poses_start) / sizeof(RecordedPose);
+
+  for (uint64_t i = 0; i < header->actor_count; ++i) {
+    const RecordingEntry &entry = entries[i];
+    if (entry.offset > pose_count || entry.count > pose_count - entry.offset) {
+      gzerr << "Recording " << _path << " is truncated.\n";
+      return false;
+    }
+    const std::string name(
+        entry.name, strnlen(entry.name, RecordingEntry::kNameSize));
+    this->tracks_[name] = RecordedTrack(poses + entry.offset, entry.count);
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+RecordedTrack TrajectoryRecording::Track(const std::string &_name) const {
+  auto track = this->tracks_.find(_name);
+  return track == this->tracks_.end() ? RecordedTrack() : track->second;
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<TrajectoryRecorder> TrajectoryRecorder::Acquire(
+    const std::string &_path, double _rate) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<TrajectoryRecorder>> instances;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<TrajectoryRecorder> recorder = instances[_path].lock();
+  if (!recorder) {
+    recorder = std::make_shared<TrajectoryRecorder>(_path, _rate);
+    instances[_path] = recorder;
+  }
+  return recorder;
+}
+
+/////////////////////////////////////////////////
+TrajectoryRecorder::TrajectoryRecorder(const std::string &_path,
+                                       double _rate)
+    : path_(_path), period_(_rate > 0 ? 1.0 / _rate : 0) {}
+
+/////////////////////////////////////////////////
+TrajectoryRecorder::~TrajectoryRecorder() {
+  if (this->Write()) {
+    gzmsg << "Recorded " << this->names_.size() << " actors to "
+          << this->path_ << ".\n";
+  }
+}
+
+/////////////////////////////////////////////////
+size_t TrajectoryRecorder::Register(const std::string &_name) {
+  if (_name.size() >= RecordingEntry::kNameSize) {
+    gzerr << "Actor name " << _name << " is longer than "
+          << RecordingEntry::kNameSize - 1
+          << " characters, its recording cannot be replayed.\n";
+  }
+  this->names_.push_back(_name);
+  this->tracks_.emplace_back();
+  return this->tracks_.size() - 1;
+}
+
+/////////////////////////////////////////////////
+void TrajectoryRecorder::Add(size_t _track, double _time, double _x,
+                             double _y, double _yaw) {
+  std::vector<RecordedPose> &poses = this->tracks_[_track];
+  while (!poses.empty() && poses.back().time > _time) poses.pop_back();
+  if (!poses.empty() && (poses.back().time == _time ||
+                         _time - poses.back().time < this->period_)) {
+    return;
+  }
+  poses.push_back({_time, _x, _y, _yaw});
+}
+
+/////////////////////////////////////////////////
+bool TrajectoryRecorder::Write() const {
+  std::vector<RecordingEntry> entries(this->names_.size());
+  uint64_t offset = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    std::memset(&entries[i], 0, sizeof(RecordingEntry));
+    std::strncpy(entries[i].name, this->names_[i].c_str(),
+                 RecordingEntry::kNameSize - 1);
+    entries[i].offset = offset;
+    entries[i].count = this->tracks_[i].size();
+    offset += entries[i].count;
+  }
+  RecordingHeader header;
+  std::memcpy(header.magic, RecordingHeader::kMagic, sizeof(header.magic));
+  header.actor_count = entries.size();
+
+  // A replay never maps a partly written file
+  const std::string tmp_path = this->path_ + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.data()),
+               entries.size() * sizeof(RecordingEntry));
+    for (const std::vector<RecordedPose> &poses : this->tracks_) {
+      file.write(reinterpret_cast<const char *>(poses.data()),
+                 poses.size() * sizeof(RecordedPose));
+    }
+    if (!file) {
+      gzerr << "Cannot write recording " << tmp_path << ".\n";
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), this->path_.c_str()) != 0) {
+    gzerr << "Cannot write recording " << this->path_ << ": "
+          << std::strerror(errno) << "\n";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,185 @@
+#include <gazebo_ros_actor_plugin/velocity_command_buffer.h>
+
+#include <algorithm>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+bool gazebo::ParseCommandPolicy(const std::string &_name,
+                                CommandPolicy &_policy) {
+  if (_name == "fifo") {
+    _policy = CommandPolicy::FIFO;
+  } else if (_name == "latest") {
+    _policy = CommandPolicy::LATEST;
+  } else if (_name == "stamped") {
+    _policy = CommandPolicy::STAMPED;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool gazebo::ParseCommandArbitration(const std::string &_name,
+                                     CommandArbitration &_arbitration) {
+  if (_name == "none") {
+    _arbitration = CommandArbitration::NONE;
+  } else if (_name == "velocity_preempts") {
+    _arbitration = CommandArbitration::VELOCITY_PREEMPTS;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+void VelocityCommandBuffer::Configure(CommandPolicy _policy,
+                                      size_t _queue_size, double _timeout) {
+  this->policy_ = _policy;
+  this->queue_size_ = std::min(std::max<size_t>(_queue_size, 1), kMaxQueueSize);
+  this->timeout_ = _timeout;
+}
+
+/////////////////////////////////////////////////
+bool VelocityCommandBuffer::Push(const VelocityCommand &_cmd) {
+  Entry entry;
+  entry.cmd = _cmd;
+  entry.sequence = ++this->pushed_;
+  if (this->ring_.Push(entry)) return true;
+
+  // The producer cannot pop the oldest command, the newest one waits in
+  // the overflow slot for the consumer
+  const uint64_t version =
+      this->overflow_version_.load(std::memory_order_relaxed);
+  this->overflow_version_.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->overflow_linear_.store(_cmd.linear, std::memory_order_relaxed);
+  this->overflow_angular_.store(_cmd.angular, std::memory_order_relaxed);
+  this->overflow_stamp_.store(_cmd.stamp, std::memory_order_relaxed);
+  ACTOR_DIAG(this->overflow_received_.store(_cmd.received,
+                                             std::memory_order_relaxed);)
+  this->overflow_sequence_.store(entry.sequence, std::memory_order_relaxed);
+  this->overflow_version_.store(version + 2, std::memory_order_release);
+  return false;
+}
+
+/////////////////////////////////////////////////
+void VelocityCommandBuffer::TakeOverflow() {
+  const uint64_t version =
+      this->overflow_version_.load(std::memory_order_acquire);
+  // A slot being written is taken at the next call
+  if (version == this->taken_version_ || (version & 1) != 0) return;
+  Entry entry;
+  entry.cmd.linear = this->overflow_linear_.load(std::memory_order_relaxed);
+  entry.cmd.angular = this->overflow_angular_.load(std::memory_order_relaxed);
+  entry.cmd.stamp = this->overflow_stamp_.load(std::memory_order_relaxed);
+  ACTOR_DIAG(entry.cmd.received =
+                 this->overflow_received_.load(std::memory_order_relaxed);)
+  entry.sequence = this->overflow_sequence_.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (this->overflow_version_.load(std::memory_order_relaxed) != version)
+    return;
+  this->taken_version_ = version;
+
+  // Only one command is held: the previous one goes, with the commands
+  // older than it to keep the pending ones in order. The ring only fills
+  // up again past the queue size of the FIFO policy, which drops them too.
+  if (this->held_) {
+    Entry oldest;
+    while (this->ring_.Peek(oldest) &&
+           oldest.sequence < this->overflow_entry_.sequence)
+      this->ring_.Pop(oldest);
+  }
+  this->overflow_entry_ = entry;
+  this->held_ = true;
+}
+
+/////////////////////////////////////////////////
+bool VelocityCommandBuffer::HeldFirst(bool _ring_front,
+                                      const Entry &_entry) const {
+  return this->held_ &&
+         (!_ring_front || this->overflow_entry_.sequence < _entry.sequence);
+}
+
+/////////////////////////////////////////////////
+bool VelocityCommandBuffer::Front(Entry &_entry) const {
+  const bool ring_front = this->ring_.Peek(_entry);
+  if (this->HeldFirst(ring_front, _entry)) {
+    _entry = this->overflow_entry_;
+    return true;
+  }
+  return ring_front;
+}
+
+/////////////////////////////////////////////////
+void VelocityCommandBuffer::PopFront() {
+  Entry oldest;
+  const bool ring_front = this->ring_.Peek(oldest);
+  if (this->HeldFirst(ring_front, oldest))
+    this->held_ = false;
+  else if (ring_front)
+    this->ring_.Pop(oldest);
+}
+
+/////////////////////////////////////////////////
+bool VelocityCommandBuffer::Next(double _now, VelocityCommand &_cmd) {
+  this->TakeOverflow();
+  bool found = false;
+  Entry entry;
+  switch (this->policy_) {
+    case CommandPolicy::FIFO: {
+      // Drop the oldest commands beyond the queue size
+      while (this->Size() > this->queue_size_) this->PopFront();
+      found = this->Front(entry);
+      if (found) {
+        _cmd = entry.cmd;
+        this->PopFront();
+      }
+      break;
+    }
+    case CommandPolicy::LATEST: {
+      while (this->Front(entry)) {
+        _cmd = entry.cmd;
+        this->PopFront();
+        found = true;
+      }
+      break;
+    }
+    case CommandPolicy::STAMPED: {
+      // Commands stamped in the future wait for the simulation to catch up
+      while (this->Front(entry) && entry.cmd.stamp <= _now) {
+        _cmd = entry.cmd;
+        this->PopFront();
+        found = true;
+      }
+      break;
+    }
+  }
+
+  if (found) {
+    this->last_applied_ = _now;
+    this->active_ = true;
+    return true;
+  }
+
+  // Stop the actor when its publisher went silent
+  if (this->active_ && this->timeout_ > 0 &&
+      _now - this->last_applied_ > this->timeout_) {
+    this->active_ = false;
+    _cmd = VelocityCommand();
+    _cmd.stamp = _now;
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+void VelocityCommandBuffer::Clear() {
+  this->ring_.Clear();
+  this->held_ = false;
+  // An overflow from before the clear is not taken anymore
+  const uint64_t version =
+      this->overflow_version_.load(std::memory_order_acquire);
+  if ((version & 1) == 0) this->taken_version_ = version;
+  this->active_ = false;
+}
@@ -0,0 +1,110 @@
+#include <gazebo_ros_actor_plugin/velocity_command_buffer.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace gazebo;
+
+namespace {
+/// \brief Command numbered by its linear velocity.
+VelocityCommand Numbered(int _number) {
+  VelocityCommand cmd;
+  cmd.linear = _number;
+  return cmd;
+}
+
+/// \brief Numbers of the commands applied by successive updates, until
+/// none is pending.
+std::vector<int> Drain(VelocityCommandBuffer &_buffer) {
+  std::vector<int> numbers;
+  VelocityCommand cmd;
+  for (double now = 1; _buffer.Next(now, cmd); ++now)
+    numbers.push_back(static_cast<int>(cmd.linear));
+  return numbers;
+}
+
+/// \brief Numbers from _first to _last.
+std::vector<int> Range(int _first, int _last) {
+  std::vector<int> numbers;
+  for (int number = _first; number <= _last; ++number)
+    numbers.push_back(number);
+  return numbers;
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+TEST(VelocityCommandBuffer, FifoKeepsNewestInOrder) {
+  VelocityCommandBuffer buffer;
+  buffer.Configure(CommandPolicy::FIFO, 8, 0);
+  for (int number = 1; number <= 20; ++number)
+    EXPECT_TRUE(buffer.Push(Numbered(number)));
+  EXPECT_EQ(Drain(buffer), Range(13, 20));
+}
+
+/////////////////////////////////////////////////
+TEST(VelocityCommandBuffer, FifoOverflowKeepsNewestInOrder) {
+  VelocityCommandBuffer buffer;
+  buffer.Configure(CommandPolicy::FIFO, VelocityCommandBuffer::kMaxQueueSize,
+                   0);
+  const int capacity = VelocityCommandBuffer::kCapacity;
+  for (int number = 1; number <= capacity; ++number)
+    EXPECT_TRUE(buffer.Push(Numbered(number)));
+  // Pushed while the ring is full, only the last one is kept
+  EXPECT_FALSE(buffer.Push(Numbered(capacity + 1)));
+  EXPECT_FALSE(buffer.Push(Numbered(capacity + 2)));
+
+  std::vector<int> expected = Range(
+      capacity - static_cast<int>(VelocityCommandBuffer::kMaxQueueSize) + 2,
+      capacity);
+  expected.push_back(capacity + 2);
+  EXPECT_EQ(Drain(buffer), expected);
+}
+
+/////////////////////////////////////////////////
+TEST(VelocityCommandBuffer, OverflowServedBeforeNewerCommands) {
+  VelocityCommandBuffer buffer;
+  buffer.Configure(CommandPolicy::FIFO, VelocityCommandBuffer::kMaxQueueSize,
+                   0);
+  const int capacity = VelocityCommandBuffer::kCapacity;
+  for (int number = 1; number <= capacity + 1; ++number)
+    buffer.Push(Numbered(number));
+
+  // The first update takes the overflow, the ring then has room again
+  VelocityCommand cmd;
+  ASSERT_TRUE(buffer.Next(0, cmd));
+  std::vector<int> applied = {static_cast<int>(cmd.linear)};
+  buffer.Push(Numbered(capacity + 2));
+  for (int number : Drain(buffer)) applied.push_back(number);
+
+  std::vector<int> expected = Range(
+      capacity - static_cast<int>(VelocityCommandBuffer::kMaxQueueSize) + 2,
+      capacity + 2);
+  EXPECT_EQ(applied, expected);
+}
+
+/////////////////////////////////////////////////
+TEST(VelocityCommandBuffer, LatestAppliesNewestAfterOverflow) {
+  VelocityCommandBuffer buffer;
+  buffer.Configure(CommandPolicy::LATEST, VelocityCommandBuffer::kMaxQueueSize,
+                   0);
+  for (int number = 1; number <= 100; ++number)
+    buffer.Push(Numbered(number));
+  EXPECT_EQ(Drain(buffer), std::vector<int>{100});
+}
+
+/////////////////////////////////////////////////
+TEST(VelocityCommandBuffer, QueueSizeClamped) {
+  VelocityCommandBuffer buffer;
+  buffer.Configure(CommandPolicy::FIFO, VelocityCommandBuffer::kCapacity, 0);
+  const int capacity = VelocityCommandBuffer::kCapacity;
+  for (int number = 1; number <= capacity; ++number)
+    buffer.Push(Numbered(number));
+  EXPECT_EQ(Drain(buffer).size(), VelocityCommandBuffer::kMaxQueueSize);
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}